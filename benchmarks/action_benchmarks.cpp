@@ -0,0 +1,127 @@
+#include "random_events.h"
+#include <catch/catch.hpp>
+#include <fsm/fsm.h>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+template <State FromState, typename EventType, State ToState>
+using Transition = FSM::Transition<State, FromState, EventType, ToState>;
+
+int transitions_count = 0;
+
+struct Count
+{
+    template <typename Event>
+    void operator()(const Event&) const
+    {
+        ++transitions_count;
+    }
+};
+
+template <State FromState, typename EventType, State ToState>
+using CountedTransition =
+    FSM::Transition<State, FromState, EventType, ToState, Count>;
+
+// Reference implementation of the machines below, written by hand.
+template <bool Counted>
+struct HandWritten
+{
+    State process(const Event0&)
+    {
+        switch (state_)
+        {
+            case NotInitialized:
+                if (Counted) ++transitions_count;
+                return state_ = Initialized;
+            case Initialized:
+                if (Counted) ++transitions_count;
+                return state_ = Started;
+            case Stopped:
+                if (Counted) ++transitions_count;
+                return state_ = NotInitialized;
+            default:
+                return state_;
+        }
+    }
+
+    State process(const Event1&)
+    {
+        switch (state_)
+        {
+            case Started:
+                if (Counted) ++transitions_count;
+                return state_ = Stopped;
+            default:
+                return state_;
+        }
+    }
+
+    State state_;
+};
+
+} // namespace
+
+TEST_CASE("Transition actions cost")
+{
+    FSM::FSM<
+        State,
+        Transition<NotInitialized, Event0, Initialized>,
+        Transition<Initialized, Event0, Started>,
+        Transition<Started, Event1, Stopped>,
+        Transition<Stopped, Event0, NotInitialized>>
+        plain(NotInitialized);
+
+    FSM::FSM<
+        State,
+        CountedTransition<NotInitialized, Event0, Initialized>,
+        CountedTransition<Initialized, Event0, Started>,
+        CountedTransition<Started, Event1, Stopped>,
+        CountedTransition<Stopped, Event0, NotInitialized>>
+        counted(NotInitialized);
+
+    HandWritten<false> plain_reference{NotInitialized};
+    HandWritten<true> counted_reference{NotInitialized};
+
+    Benchmarks::random_events<2>();
+
+    BENCHMARK("FSM without actions")
+    {
+        Benchmarks::run<Event0, Event1>(plain);
+    }
+
+    BENCHMARK("hand-written switch without actions")
+    {
+        Benchmarks::run<Event0, Event1>(plain_reference);
+    }
+
+    REQUIRE(plain.state_ == plain_reference.state_);
+
+    transitions_count = 0;
+
+    BENCHMARK("FSM with actions")
+    {
+        Benchmarks::run<Event0, Event1>(counted);
+    }
+
+    const auto count = transitions_count;
+    transitions_count = 0;
+
+    BENCHMARK("hand-written switch with actions")
+    {
+        Benchmarks::run<Event0, Event1>(counted_reference);
+    }
+
+    REQUIRE(counted.state_ == counted_reference.state_);
+    REQUIRE(count == transitions_count);
+}
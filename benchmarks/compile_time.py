@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Measures the time and memory needed to compile a synthetic machine.
+
+The machine has the requested number of transitions, spread over ten events
+and one tenth as many states, each transition leaving a distinct state on its
+event. The script fails when the compilation exceeds the given budgets, so
+that compile time regressions are caught by `ninja benchmark`.
+
+Time is the processor time of the compiler, as a multiple of the time it takes
+to compile the same headers without any machine, so that budgets hold on
+slower or loaded hosts.
+"""
+
+import argparse
+import os
+import resource
+import subprocess
+import sys
+import tempfile
+
+EVENTS = 10
+
+# Number of times the reference is compiled, the fastest one being kept.
+REFERENCE_RUNS = 3
+
+HEADERS = [
+    '#include <fsm/fsm.h>',
+    '#include <fsm/pool.h>',
+    '#include <iostream>',
+    '',
+]
+
+
+def generate_reference():
+    return '\n'.join(HEADERS + [
+        'int main()',
+        '{',
+        '    std::cout << 0;',
+        '}',
+        '',
+    ])
+
+
+def generate(transitions):
+    states = max(transitions // EVENTS, 1)
+    lines = HEADERS + [
+        'enum State : int',
+        '{',
+        '};',
+        '',
+    ]
+    lines += ['struct Event{} {{}};'.format(event) for event in range(EVENTS)]
+    lines += ['', 'using Machine = FSM::FSM<', '    State,']
+    machine = []
+
+    for index in range(transitions):
+        event = index % EVENTS
+        from_state = index // EVENTS % states
+        to_state = (from_state + 1 + event) % states
+        machine.append(
+            '    FSM::Transition<State, State({}), Event{}, State({})>'.format(
+                from_state, event, to_state))
+
+    lines.append(',\n'.join(machine) + '>;')
+    lines += [
+        '',
+        'using Pool = FSM::FSMPool<',
+        '    State,',
+        ',\n'.join(machine) + '>;',
+        '',
+        'int main()',
+        '{',
+        '    Machine machine(State(0));',
+        '    Pool pool(1024, State(0));',
+        '',
+    ]
+
+    for event in range(EVENTS):
+        lines.append('    machine.process(Event{}());'.format(event))
+        lines.append('    pool.process_all(Event{}());'.format(event))
+
+    lines += [
+        '    machine.process_id(0);',
+        '    Machine::report(std::cout);',
+        '    return machine.state_ + pool.state(0);',
+        '}',
+        '',
+    ]
+
+    return '\n'.join(lines)
+
+
+def compile_source(compiler, includes, directory, name, code):
+    """Compiles code and returns whether it succeeded and the processor time
+    the compiler used, in seconds."""
+    source = os.path.join(directory, name + '.cpp')
+
+    with open(source, 'w') as output:
+        output.write(code)
+
+    command = compiler + ['-std=c++14', '-O2', '-c', source]
+    command += ['-I' + include for include in includes]
+    command += ['-o', os.path.join(directory, name + '.o')]
+
+    before = resource.getrusage(resource.RUSAGE_CHILDREN)
+    result = subprocess.run(command)
+    after = resource.getrusage(resource.RUSAGE_CHILDREN)
+    seconds = (after.ru_utime - before.ru_utime
+               + after.ru_stime - before.ru_stime)
+
+    return result.returncode == 0, seconds
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--transitions', type=int, required=True)
+    parser.add_argument('--include', action='append', default=[])
+    parser.add_argument('--max-ratio', type=float,
+                        help='processor time budget, as a multiple of the '
+                        'time needed to compile the headers alone')
+    parser.add_argument('--max-megabytes', type=float)
+    parser.add_argument('compiler', nargs='+')
+    arguments = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        references = []
+
+        for _ in range(REFERENCE_RUNS):
+            succeeded, seconds = compile_source(
+                arguments.compiler, arguments.include, directory,
+                'reference', generate_reference())
+
+            if not succeeded:
+                print('reference compilation failed')
+                return 1
+
+            references.append(seconds)
+
+        succeeded, seconds = compile_source(
+            arguments.compiler, arguments.include, directory, 'machine',
+            generate(arguments.transitions))
+
+    reference = max(min(references), 0.01)
+    ratio = seconds / reference
+
+    # Peak resident set size of the largest terminated descendant, that is the
+    # compiler proper rather than its driver, in kilobytes on Linux.
+    megabytes = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss / 1024
+
+    print('{} transitions: {:.2f} s, {:.1f} times the {:.2f} s of the '
+          'reference, {:.1f} MB'.format(
+              arguments.transitions, seconds, ratio, reference, megabytes))
+
+    if not succeeded:
+        print('compilation failed')
+        return 1
+
+    if arguments.max_ratio is not None and ratio > arguments.max_ratio:
+        print('exceeded {} times the reference budget'.format(
+            arguments.max_ratio))
+        return 1
+
+    if (arguments.max_megabytes is not None
+            and megabytes > arguments.max_megabytes):
+        print('exceeded {} MB budget'.format(arguments.max_megabytes))
+        return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,140 @@
+#include "random_events.h"
+#include <catch/catch.hpp>
+#include <fsm/composed.h>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+struct Toggle {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+enum Ring
+{
+    First,
+    Second,
+    Third
+};
+
+enum Switch
+{
+    Off,
+    On
+};
+
+using Lifecycle = FSM::FSM<
+    State,
+    FSM::Transition<State, NotInitialized, Event0, Initialized>,
+    FSM::Transition<State, Initialized, Event0, Started>,
+    FSM::Transition<State, Started, Event1, Stopped>,
+    FSM::Transition<State, Stopped, Event0, NotInitialized>>;
+
+using Rotation = FSM::FSM<
+    Ring,
+    FSM::Transition<Ring, First, Event0, Second>,
+    FSM::Transition<Ring, Second, Toggle, Third>,
+    FSM::Transition<Ring, Third, Event1, First>>;
+
+using Light = FSM::FSM<
+    Switch,
+    FSM::Transition<Switch, Off, Toggle, On>,
+    FSM::Transition<Switch, On, Toggle, Off>,
+    FSM::Transition<Switch, On, Event1, Off>>;
+
+using Gate = FSM::FSM<
+    Switch,
+    FSM::Transition<Switch, Off, Event1, On>,
+    FSM::Transition<Switch, On, Event0, Off>>;
+
+// Regions kept as separate machines, every event being sent to each of them.
+struct Separate
+{
+    template <typename Event>
+    void process(const Event& event)
+    {
+        lifecycle.process(event);
+        rotation.process(event);
+        light.process(event);
+        gate.process(event);
+    }
+
+    int sum() const
+    {
+        return lifecycle.state_ + rotation.state_ + light.state_ + gate.state_;
+    }
+
+    Lifecycle lifecycle{NotInitialized};
+    Rotation rotation{First};
+    Light light{Off};
+    Gate gate{Off};
+};
+
+struct Composed
+{
+    template <typename Event>
+    void process(const Event& event)
+    {
+        machine.process(event);
+    }
+
+    int sum() const
+    {
+        return machine.state<0>() + machine.state<1>() + machine.state<2>()
+            + machine.state<3>();
+    }
+
+    FSM::ComposedFSM<Lifecycle, Rotation, Light, Gate> machine;
+};
+
+// Same events processed by index, without branching on their types.
+int run_indices(Composed& composed)
+{
+    for (const auto event : Benchmarks::random_events<3>())
+    {
+        composed.machine.process_id(event);
+    }
+
+    return composed.sum();
+}
+
+} // namespace
+
+TEST_CASE("ComposedFSM")
+{
+    Separate separate;
+    Composed composed;
+    Composed indexed;
+
+    Benchmarks::random_events<3>();
+
+    int separate_sum = 0;
+    int composed_sum = 0;
+    int indexed_sum = 0;
+
+    BENCHMARK("separate regions")
+    {
+        Benchmarks::run<Event0, Event1, Toggle>(separate);
+        separate_sum += separate.sum();
+    }
+
+    BENCHMARK("composed regions")
+    {
+        Benchmarks::run<Event0, Event1, Toggle>(composed);
+        composed_sum += composed.sum();
+    }
+
+    BENCHMARK("composed regions, events by index")
+    {
+        indexed_sum += run_indices(indexed);
+    }
+
+    REQUIRE(separate_sum == composed_sum);
+    REQUIRE(separate_sum == indexed_sum);
+}
@@ -0,0 +1,168 @@
+#include <catch/catch.hpp>
+#include <fsm/executor.h>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+using Machine = FSM::FSM<
+    State,
+    FSM::Transition<State, NotInitialized, Event0, Initialized>,
+    FSM::Transition<State, Initialized, Event0, Started>,
+    FSM::Transition<State, Started, Event1, Stopped>,
+    FSM::Transition<State, Stopped, Event0, NotInitialized>>;
+
+std::atomic<bool> ponged{false};
+
+// Instrumentation telling the benchmark that an event was processed.
+struct Pong
+{
+    static constexpr bool enabled = true;
+
+    template <std::size_t StateCount, std::size_t EventCount>
+    struct Instance
+    {
+        void on_transition(std::size_t, std::size_t, std::size_t)
+        {
+            ponged.store(true, std::memory_order_release);
+        }
+
+        void on_reject(std::size_t, std::size_t) {}
+    };
+};
+
+enum Ball
+{
+    Here
+};
+
+using PingPong =
+    FSM::BasicFSM<Ball, Pong, FSM::Transition<Ball, Here, Event0, Here>>;
+
+const std::size_t instances = 1 << 20;
+const std::size_t producers = 2;
+const std::size_t events_per_producer = 1 << 20;
+const int round_trips = 10000;
+
+// Events submitted by every producer, as instance and event index pairs drawn
+// at random.
+const std::vector<std::vector<std::pair<std::size_t, std::size_t>>>& events()
+{
+    static const auto events = [] {
+        std::vector<std::vector<std::pair<std::size_t, std::size_t>>> events(
+            producers);
+        std::mt19937 random(42);
+
+        for (auto& producer_events : events)
+        {
+            producer_events.resize(events_per_producer);
+
+            for (auto& event : producer_events)
+            {
+                event = {random() % instances, random() % 2};
+            }
+        }
+
+        return events;
+    }();
+
+    return events;
+}
+
+// Worker counts from 1 to the number of hardware threads.
+std::vector<std::size_t> thread_counts()
+{
+    const std::size_t hardware =
+        std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::size_t> counts;
+
+    for (std::size_t count = 1; count < hardware; count *= 2)
+    {
+        counts.push_back(count);
+    }
+
+    counts.push_back(hardware);
+    return counts;
+}
+
+} // namespace
+
+TEST_CASE("FSMExecutor throughput")
+{
+    events();
+
+    for (const auto threads : thread_counts())
+    {
+        FSM::ExecutorOptions options;
+        options.shards = 256;
+        options.threads = threads;
+
+        FSM::FSMExecutor<Machine> executor(
+            instances, Machine(NotInitialized), options);
+
+        BENCHMARK(
+            std::to_string(producers * events_per_producer) + " events, "
+            + std::to_string(threads) + " workers")
+        {
+            std::vector<std::thread> submitters;
+
+            for (const auto& producer_events : events())
+            {
+                submitters.emplace_back([&executor, &producer_events] {
+                    for (const auto& event : producer_events)
+                    {
+                        executor.submit_id(event.first, event.second);
+                    }
+                });
+            }
+
+            for (auto& submitter : submitters)
+            {
+                submitter.join();
+            }
+
+            executor.drain();
+        }
+    }
+}
+
+TEST_CASE("FSMExecutor latency")
+{
+    for (const auto threads : thread_counts())
+    {
+        FSM::ExecutorOptions options;
+        options.threads = threads;
+
+        FSM::FSMExecutor<PingPong> executor(1, PingPong(Here), options);
+
+        BENCHMARK(
+            std::to_string(round_trips) + " round trips, "
+            + std::to_string(threads) + " workers")
+        {
+            for (int round = 0; round < round_trips; ++round)
+            {
+                ponged.store(false, std::memory_order_relaxed);
+                executor.submit(0, Event0());
+
+                while (!ponged.load(std::memory_order_acquire))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+}
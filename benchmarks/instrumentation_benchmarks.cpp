@@ -0,0 +1,96 @@
+#include "random_events.h"
+#include <catch/catch.hpp>
+#include <fsm/instrumentation.h>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+template <typename Policy>
+using Machine = FSM::BasicFSM<
+    State,
+    Policy,
+    FSM::Transition<State, NotInitialized, Event0, Initialized>,
+    FSM::Transition<State, Initialized, Event0, Started>,
+    FSM::Transition<State, Started, Event1, Stopped>,
+    FSM::Transition<State, Stopped, Event0, NotInitialized>>;
+
+} // namespace
+
+TEST_CASE("Instrumentation cost")
+{
+    Machine<FSM::NoInstrumentation> plain(NotInitialized);
+    Machine<FSM::TransitionCounters> transitions(NotInitialized);
+    Machine<FSM::RejectionCounters> rejections(NotInitialized);
+    Machine<FSM::DwellTimeHistograms<FSM::SteadyClock>> steady(NotInitialized);
+#if defined(__x86_64__) || defined(__i386__)
+    Machine<FSM::DwellTimeHistograms<FSM::TscClock>> tsc(NotInitialized);
+#endif
+    Machine<FSM::TraceBuffer<>> traced(NotInitialized);
+    Machine<FSM::Instrumentation<
+        FSM::TransitionCounters,
+        FSM::RejectionCounters,
+        FSM::DwellTimeHistograms<>,
+        FSM::TraceBuffer<>>>
+        everything(NotInitialized);
+
+    Benchmarks::random_events<2>();
+
+    BENCHMARK("no instrumentation")
+    {
+        Benchmarks::run<Event0, Event1>(plain);
+    }
+
+    BENCHMARK("transition counters")
+    {
+        Benchmarks::run<Event0, Event1>(transitions);
+    }
+
+    REQUIRE(transitions.state_ == plain.state_);
+
+    BENCHMARK("rejection counters")
+    {
+        Benchmarks::run<Event0, Event1>(rejections);
+    }
+
+    REQUIRE(rejections.state_ == plain.state_);
+
+    BENCHMARK("dwell time histograms, steady clock")
+    {
+        Benchmarks::run<Event0, Event1>(steady);
+    }
+
+    REQUIRE(steady.state_ == plain.state_);
+
+#if defined(__x86_64__) || defined(__i386__)
+    BENCHMARK("dwell time histograms, time stamp counter")
+    {
+        Benchmarks::run<Event0, Event1>(tsc);
+    }
+
+    REQUIRE(tsc.state_ == plain.state_);
+#endif
+
+    BENCHMARK("trace buffer")
+    {
+        Benchmarks::run<Event0, Event1>(traced);
+    }
+
+    REQUIRE(traced.state_ == plain.state_);
+
+    BENCHMARK("every feature")
+    {
+        Benchmarks::run<Event0, Event1>(everything);
+    }
+
+    REQUIRE(everything.state_ == plain.state_);
+}
@@ -0,0 +1,86 @@
+#include <catch/catch.hpp>
+#include <fsm/pool.h>
+#include <vector>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+template <State FromState, typename EventType, State ToState>
+using Transition = FSM::Transition<State, FromState, EventType, ToState>;
+
+template <template <typename, typename...> class Machine>
+using Example = Machine<
+    State,
+    Transition<NotInitialized, Event0, Initialized>,
+    Transition<Initialized, Event0, Started>,
+    Transition<Started, Event1, Stopped>,
+    Transition<Stopped, Event0, NotInitialized>>;
+
+constexpr std::size_t instances = 1 << 20;
+constexpr int rounds = 16;
+
+} // namespace
+
+TEST_CASE("FSMPool throughput")
+{
+    std::vector<Example<FSM::FSM>> machines(
+        instances, Example<FSM::FSM>(NotInitialized));
+    Example<FSM::FSMPool> pool(instances, NotInitialized);
+    std::vector<std::size_t> indices;
+
+    for (std::size_t index = 0; index < instances; index += 7)
+    {
+        indices.push_back(index);
+    }
+
+    BENCHMARK("separate FSM objects")
+    {
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (auto& machine : machines) machine.process(Event0());
+            for (auto& machine : machines) machine.process(Event1());
+        }
+    }
+
+    BENCHMARK("FSMPool::process_all")
+    {
+        for (int round = 0; round < rounds; ++round)
+        {
+            pool.process_all(Event0());
+            pool.process_all(Event1());
+        }
+    }
+
+    BENCHMARK("separate FSM objects, one in seven")
+    {
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (auto index : indices) machines[index].process(Event0());
+            for (auto index : indices) machines[index].process(Event1());
+        }
+    }
+
+    BENCHMARK("FSMPool::process_indices, one in seven")
+    {
+        for (int round = 0; round < rounds; ++round)
+        {
+            pool.process_indices(Event0(), indices.begin(), indices.end());
+            pool.process_indices(Event1(), indices.begin(), indices.end());
+        }
+    }
+
+    for (std::size_t index = 0; index < instances; ++index)
+    {
+        REQUIRE(pool.state(index) == machines[index].state_);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef FSM_BENCHMARKS_RANDOM_EVENTS_H
+#define FSM_BENCHMARKS_RANDOM_EVENTS_H
+
+#include <fsm/fsm.h>
+
+#include <random>
+#include <vector>
+
+namespace Benchmarks {
+
+// Indices of the events to process, drawn at random among EventCount so that
+// the compiler cannot predict the states of the machines.
+template <unsigned EventCount>
+const std::vector<unsigned char>& random_events()
+{
+    static const std::vector<unsigned char> events = [] {
+        std::mt19937 random(42);
+        std::vector<unsigned char> events(1 << 22);
+
+        for (auto& event : events)
+        {
+            event = random() % EventCount;
+        }
+
+        return events;
+    }();
+
+    return events;
+}
+
+namespace detail {
+template <typename Machine>
+void process(Machine&, unsigned, FSM::TypeList<>)
+{
+}
+
+template <typename Machine, typename Event, typename... Events>
+void process(
+    Machine& machine,
+    const unsigned index,
+    FSM::TypeList<Event, Events...>)
+{
+    if (index == 0)
+    {
+        machine.process(Event());
+    }
+    else
+    {
+        process(machine, index - 1, FSM::TypeList<Events...>());
+    }
+}
+} // namespace detail
+
+// Processes the random events, each index standing for the type at that
+// position in Events.
+template <typename... Events, typename Machine>
+void run(Machine& machine)
+{
+    for (const auto event : random_events<sizeof...(Events)>())
+    {
+        detail::process(machine, event, FSM::TypeList<Events...>());
+    }
+}
+} // namespace Benchmarks
+
+#endif
@@ -0,0 +1,109 @@
+#include <catch/catch.hpp>
+#include <fsm/snapshot.h>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+using Pool = FSM::FSMPool<
+    State,
+    FSM::Transition<State, NotInitialized, Event0, Initialized>,
+    FSM::Transition<State, Initialized, Event0, Started>,
+    FSM::Transition<State, Started, Event1, Stopped>,
+    FSM::Transition<State, Stopped, Event0, NotInitialized>>;
+
+const std::size_t instances = 10000000;
+
+// Snapshot files removed at the end of the benchmark.
+struct TemporaryFiles
+{
+    ~TemporaryFiles()
+    {
+        for (const auto& path : paths)
+        {
+            std::remove(path.c_str());
+        }
+    }
+
+    std::vector<std::string> paths;
+};
+
+} // namespace
+
+TEST_CASE("Snapshots of 10M instances")
+{
+    TemporaryFiles files{
+        {"snapshot_benchmark.fsm", "snapshot_benchmark_delta.fsm"}};
+    const auto& full = files.paths[0];
+    const auto& delta = files.paths[1];
+
+    Pool pool(instances, NotInitialized);
+    std::mt19937 random(42);
+
+    for (std::size_t index = 0; index < pool.size(); ++index)
+    {
+        pool.set_state(index, State(random() % 4));
+    }
+
+    BENCHMARK("save full snapshot")
+    {
+        FSM::save_snapshot(pool, full);
+    }
+
+    Pool restored(instances, NotInitialized);
+    FSM::SnapshotPosition position;
+
+    BENCHMARK("open snapshot view")
+    {
+        FSM::SnapshotView<Pool> view(full);
+        REQUIRE(view.size() == instances);
+    }
+
+    BENCHMARK("restore full snapshot")
+    {
+        FSM::restore_snapshot(restored, full);
+    }
+
+    REQUIRE(restored.state(instances - 1) == pool.state(instances - 1));
+
+    FSM::DeltaCheckpoint<Pool> checkpoint(pool, full);
+    FSM::restore_snapshot(restored, full, position);
+
+    // One instance in a hundred changes between checkpoints.
+    std::vector<std::size_t> changed(instances / 100);
+
+    for (auto& index : changed)
+    {
+        index = random() % instances;
+    }
+
+    pool.process_indices(Event0(), changed.begin(), changed.end());
+
+    BENCHMARK("save delta snapshot, 1% changed")
+    {
+        checkpoint.save(pool, delta);
+    }
+
+    BENCHMARK("restore delta snapshot, 1% changed")
+    {
+        FSM::restore_snapshot(restored, delta, position);
+    }
+
+    for (const auto index : changed)
+    {
+        REQUIRE(restored.state(index) == pool.state(index));
+    }
+}
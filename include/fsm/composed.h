@@ -0,0 +1,534 @@
+#ifndef FSM_COMPOSED_H
+#define FSM_COMPOSED_H
+
+#include <fsm/fsm.h>
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace FSM {
+
+namespace detail {
+template <typename Machine>
+struct Region;
+
+template <typename StateType, typename Policy, typename... Transitions>
+struct Region<BasicFSM<StateType, Policy, Transitions...>>
+{
+    static_assert(
+        !AnyBehavior<Transitions...>::value,
+        "the regions of a composed machine cannot have actions or guards");
+    static_assert(
+        std::is_same<Policy, NoInstrumentation>::value,
+        "the regions of a composed machine cannot be instrumented");
+
+    using State = StateType;
+    using Events = EventList<Transitions...>;
+
+    static constexpr std::size_t state_count =
+        StateCount<StateType, Transitions...>();
+    static constexpr std::size_t initial = 0;
+
+    // Transitions of the region, indexed by state and by the index of the
+    // event in AllEvents.
+    template <typename AllEvents>
+    static constexpr ConstArray<std::size_t, state_count * AllEvents::size>
+    table()
+    {
+        return event_table<
+            std::size_t,
+            state_count,
+            AllEvents,
+            Transitions...>();
+    }
+};
+} // namespace detail
+
+// Region of a ComposedFSM starting in InitialState rather than in the state
+// of value 0.
+template <
+    typename Machine,
+    typename detail::Region<Machine>::State InitialState>
+struct Start
+{
+};
+
+namespace detail {
+template <typename Machine, typename Region<Machine>::State InitialState>
+struct Region<Start<Machine, InitialState>> : Region<Machine>
+{
+    static_assert(
+        std::size_t(InitialState) < Region<Machine>::state_count,
+        "the initial state of a region must be one of its states");
+
+    static constexpr std::size_t initial = std::size_t(InitialState);
+};
+
+template <typename... Lists>
+struct Concat;
+
+template <typename... Types>
+struct Concat<TypeList<Types...>>
+{
+    using type = TypeList<Types...>;
+};
+
+template <typename... First, typename... Second, typename... Lists>
+struct Concat<TypeList<First...>, TypeList<Second...>, Lists...>
+    : Concat<TypeList<First..., Second...>, Lists...>
+{
+};
+
+template <typename List>
+struct UniqueList;
+
+template <typename... Types>
+struct UniqueList<TypeList<Types...>>
+{
+    using type = typename Unique<Types...>::type;
+};
+
+// Transitions of every region, in the representation used to search the
+// product of the regions.
+// A product state is the mixed radix number whose digits are the states of
+// the regions, the first region being the least significant digit. A
+// transition of a region is stored as the difference it makes to the product
+// state, modulo the size of std::size_t, and the regions whose state may
+// change on every event are listed, event after event, so that the others are
+// skipped.
+template <
+    std::size_t RegionCount,
+    std::size_t EventCount,
+    std::size_t TableSize>
+struct ProductLayout
+{
+    ConstArray<std::size_t, RegionCount> counts;
+    ConstArray<std::size_t, RegionCount> strides;
+    ConstArray<std::size_t, RegionCount> offsets;
+    ConstArray<std::size_t, TableSize> deltas;
+    ConstArray<std::size_t, EventCount * RegionCount> movers;
+    ConstArray<std::size_t, EventCount> mover_counts;
+    std::size_t mover_count;
+    std::size_t initial;
+};
+
+// Product states reachable from the initial one, numbered in breadth first
+// order: order holds the product state of every number, ids one more than the
+// number of every product state, or 0 if it is unreachable, and next the
+// number reached from every number on every event, at number * EventCount +
+// event. The search stops without being complete when more than Limit states
+// are reachable.
+template <std::size_t Size, std::size_t Limit, std::size_t EventCount>
+struct ProductSearch
+{
+    ConstArray<std::size_t, Size> ids;
+    ConstArray<std::size_t, Limit> order;
+    ConstArray<std::size_t, Limit * EventCount> next;
+    std::size_t count;
+    bool complete;
+};
+
+// Largest number of reachable product states searched, so that the search
+// and the tables built from it stay within half of the default limit of GCC
+// on the operations of a constant evaluation, 2^25. Searching a state takes
+// about 70 operations, plus as many for every event and for every region
+// moving on an event.
+constexpr std::size_t product_state_limit(
+    std::size_t event_count,
+    std::size_t mover_count)
+{
+    return (std::size_t(1) << 24) / (70 * (1 + event_count + mover_count));
+}
+
+// Arrays are accessed without calling their operator[] and the states of the
+// regions are only decoded when they move, so that the search stays within
+// the limits of constant evaluation for tens of thousands of states.
+template <
+    std::size_t Size,
+    std::size_t Limit,
+    std::size_t RegionCount,
+    std::size_t EventCount,
+    std::size_t TableSize>
+constexpr ProductSearch<Size, Limit, EventCount> search_product(
+    const ProductLayout<RegionCount, EventCount, TableSize>& layout)
+{
+    ProductSearch<Size, Limit, EventCount> result{};
+    const auto& counts = layout.counts.values;
+    const auto& strides = layout.strides.values;
+    const auto& offsets = layout.offsets.values;
+    const auto& deltas = layout.deltas.values;
+    const auto& movers = layout.movers.values;
+    const auto& mover_counts = layout.mover_counts.values;
+    auto& ids = result.ids.values;
+    auto& order = result.order.values;
+    auto& next = result.next.values;
+    std::size_t count = 1;
+    std::size_t transition = 0;
+
+    ids[layout.initial] = 1;
+    order[0] = layout.initial;
+
+    for (std::size_t index = 0; index < count; ++index)
+    {
+        const auto product = order[index];
+        std::size_t mover = 0;
+
+        for (std::size_t event = 0; event < EventCount; ++event)
+        {
+            auto target = product;
+
+            for (const auto end = mover + mover_counts[event]; mover < end;
+                 ++mover)
+            {
+                const auto region = movers[mover];
+                target += deltas
+                    [offsets[region] + event
+                     + product / strides[region] % counts[region]
+                         * EventCount];
+            }
+
+            auto& id = ids[target];
+
+            if (id == 0)
+            {
+                if (count == Limit)
+                {
+                    result.count = count;
+                    return result;
+                }
+
+                order[count] = target;
+                id = ++count;
+            }
+
+            next[transition++] = id - 1;
+        }
+    }
+
+    result.count = count;
+    result.complete = true;
+    return result;
+}
+
+template <typename Value, std::size_t Size, std::size_t Count>
+constexpr bool copy_into(
+    ConstArray<Value, Size>& destination,
+    std::size_t offset,
+    const ConstArray<Value, Count>& source)
+{
+    for (std::size_t index = 0; index < Count; ++index)
+    {
+        destination[offset + index] = source[index];
+    }
+
+    return true;
+}
+
+constexpr std::size_t product(std::initializer_list<std::size_t> values)
+{
+    std::size_t result = 1;
+
+    for (const auto value : values)
+    {
+        result *= value;
+    }
+
+    return result;
+}
+
+constexpr std::size_t sum(std::initializer_list<std::size_t> values)
+{
+    std::size_t result = 0;
+
+    for (const auto value : values)
+    {
+        result += value;
+    }
+
+    return result;
+}
+
+// Regions of a ComposedFSM and the layout of their product.
+template <typename... Regions>
+struct Product
+{
+    using Events = typename UniqueList<
+        typename Concat<typename Region<Regions>::Events...>::type>::type;
+
+    static constexpr std::size_t region_count = sizeof...(Regions);
+    static constexpr std::size_t event_count = Events::size;
+    static constexpr std::size_t size =
+        product({Region<Regions>::state_count...});
+
+    using Layout = ProductLayout<
+        region_count,
+        event_count,
+        sum({Region<Regions>::state_count...}) * event_count>;
+
+    template <std::size_t... Indices>
+    static constexpr Layout layout(std::index_sequence<Indices...>)
+    {
+        constexpr std::size_t counts[] = {Region<Regions>::state_count...};
+        constexpr std::size_t initials[] = {Region<Regions>::initial...};
+
+        Layout result{};
+        std::size_t stride = 1;
+        std::size_t offset = 0;
+
+        for (std::size_t region = 0; region < region_count; ++region)
+        {
+            result.counts[region] = counts[region];
+            result.strides[region] = stride;
+            result.offsets[region] = offset;
+            result.initial += initials[region] * stride;
+            stride *= counts[region];
+            offset += counts[region] * event_count;
+        }
+
+        const bool expanded[] = {
+            true,
+            copy_into(
+                result.deltas,
+                result.offsets[Indices],
+                Region<Regions>::template table<Events>())...};
+        (void)expanded;
+
+        // Regions moving on every event, at event * region count.
+        std::size_t movers[event_count > 0 ? event_count * region_count : 1] =
+            {};
+
+        for (std::size_t region = 0; region < region_count; ++region)
+        {
+            bool moves[event_count > 0 ? event_count : 1] = {};
+
+            for (std::size_t state = 0; state < counts[region]; ++state)
+            {
+                for (std::size_t event = 0; event < event_count; ++event)
+                {
+                    auto& delta = result.deltas
+                        [result.offsets[region] + state * event_count + event];
+
+                    moves[event] |= delta != state;
+                    delta = (delta - state) * result.strides[region];
+                }
+            }
+
+            for (std::size_t event = 0; event < event_count; ++event)
+            {
+                if (moves[event])
+                {
+                    movers
+                        [event * region_count + result.mover_counts[event]++] =
+                        region;
+                    ++result.mover_count;
+                }
+            }
+        }
+
+        std::size_t mover = 0;
+
+        for (std::size_t event = 0; event < event_count; ++event)
+        {
+            for (std::size_t index = 0; index < result.mover_counts[event];
+                 ++index)
+            {
+                result.movers[mover++] = movers[event * region_count + index];
+            }
+        }
+
+        return result;
+    }
+
+    static constexpr Layout layout()
+    {
+        return layout(std::index_sequence_for<Regions...>{});
+    }
+};
+
+// Next product state, at event index * state count + product state.
+template <
+    typename Narrow,
+    std::size_t EventCount,
+    std::size_t StateCount,
+    typename Search>
+constexpr ConstArray<Narrow, EventCount * StateCount> composed_transitions(
+    const Search& search)
+{
+    ConstArray<Narrow, EventCount * StateCount> result{};
+
+    for (std::size_t event = 0; event < EventCount; ++event)
+    {
+        for (std::size_t state = 0; state < StateCount; ++state)
+        {
+            result.values[event * StateCount + state] =
+                Narrow(search.next.values[state * EventCount + event]);
+        }
+    }
+
+    return result;
+}
+
+// State of every region, at product state * region count + region.
+template <
+    typename Narrow,
+    std::size_t RegionCount,
+    std::size_t StateCount,
+    typename Layout,
+    typename Search>
+constexpr ConstArray<Narrow, StateCount * RegionCount> composed_regions(
+    const Layout& layout,
+    const Search& search)
+{
+    ConstArray<Narrow, StateCount * RegionCount> result{};
+
+    for (std::size_t state = 0; state < StateCount; ++state)
+    {
+        const auto product = search.order.values[state];
+
+        for (std::size_t region = 0; region < RegionCount; ++region)
+        {
+            result.values[state * RegionCount + region] = Narrow(
+                product / layout.strides.values[region]
+                % layout.counts.values[region]);
+        }
+    }
+
+    return result;
+}
+} // namespace detail
+
+// Tables of a ComposedFSM, built at compile time from those of its regions.
+// Only the product states reachable from the initial states of the regions
+// are numbered, so that the tables do not grow with the unreachable ones.
+template <typename... Regions>
+struct ComposedTable
+{
+    using Product = detail::Product<Regions...>;
+    using Events = typename Product::Events;
+    using Layout = typename Product::Layout;
+
+    static constexpr std::size_t region_count = Product::region_count;
+    static constexpr std::size_t event_count = Product::event_count;
+
+    // The product is searched once, the tables below being built from the
+    // result.
+    static constexpr Layout layout = Product::layout();
+
+    // Largest number of reachable product states.
+    static constexpr std::size_t state_limit = std::min(
+        Product::size,
+        detail::product_state_limit(event_count, layout.mover_count));
+
+    using Search =
+        detail::ProductSearch<Product::size, state_limit, event_count>;
+
+    static constexpr Search search =
+        detail::search_product<Product::size, state_limit>(layout);
+
+    static_assert(
+        search.complete,
+        "the regions of a composed machine have too many reachable "
+        "combinations of states to be composed at compile time");
+
+    // Number of reachable product states.
+    static constexpr std::size_t state_count = search.count;
+
+    using Narrow = typename NarrowStateHelper<state_count>::type;
+    using RegionNarrow = typename NarrowStateHelper<std::max(
+        {detail::Region<Regions>::state_count...})>::type;
+
+    // The tables are kept as they are built rather than copied into
+    // std::array, which takes an index sequence as long as them.
+    using TransitionArray =
+        detail::ConstArray<Narrow, event_count * state_count>;
+    using RegionArray =
+        detail::ConstArray<RegionNarrow, state_count * region_count>;
+
+    static constexpr TransitionArray transitions =
+        detail::composed_transitions<Narrow, event_count, state_count>(search);
+
+    static constexpr RegionArray regions =
+        detail::composed_regions<RegionNarrow, region_count, state_count>(
+            layout, search);
+};
+
+template <typename... Regions>
+constexpr typename ComposedTable<Regions...>::Layout
+    ComposedTable<Regions...>::layout;
+
+template <typename... Regions>
+constexpr std::size_t ComposedTable<Regions...>::state_limit;
+
+template <typename... Regions>
+constexpr typename ComposedTable<Regions...>::Search
+    ComposedTable<Regions...>::search;
+
+template <typename... Regions>
+constexpr typename ComposedTable<Regions...>::TransitionArray
+    ComposedTable<Regions...>::transitions;
+
+template <typename... Regions>
+constexpr typename ComposedTable<Regions...>::RegionArray
+    ComposedTable<Regions...>::regions;
+
+// Machines running side by side and receiving the same events, merged into a
+// single machine whose states are the reachable combinations of their
+// states, so that one table lookup advances all of them.
+// Regions are FSM types, optionally wrapped in Start to set their initial
+// state, and must have neither actions, guards nor instrumentation.
+template <typename... Regions>
+struct ComposedFSM
+{
+    using Table = ComposedTable<Regions...>;
+    using Events = typename Table::Events;
+
+    // State type of a region.
+    template <std::size_t Index>
+    using RegionState =
+        typename detail::Region<TypeAt<Index, Regions...>>::State;
+
+    static constexpr std::size_t region_count = Table::region_count;
+    static constexpr std::size_t event_count = Table::event_count;
+    static constexpr std::size_t state_count = Table::state_count;
+
+    // Index of an event type, as accepted by process_id.
+    // Event types known to no region get event_count.
+    template <typename Event>
+    static constexpr std::size_t event_index()
+    {
+        return IndexOf<Events, Event>::value;
+    }
+
+    // Every region starts in its initial state.
+    ComposedFSM() : state_(0) {}
+
+    template <typename Event>
+    void process(const Event&)
+    {
+        process_id(event_index<Event>());
+    }
+
+    // Process an event known by its index rather than by its type.
+    // Indices out of range are ignored.
+    void process_id(const std::size_t event_index)
+    {
+        if (event_index < event_count)
+        {
+            state_ = Table::transitions[event_index * state_count + state_];
+        }
+    }
+
+    template <std::size_t Index>
+    RegionState<Index> state() const
+    {
+        return RegionState<Index>(
+            Table::regions[std::size_t(state_) * region_count + Index]);
+    }
+
+private:
+    typename Table::Narrow state_;
+};
+}; // namespace FSM
+
+#endif
@@ -0,0 +1,441 @@
+#ifndef FSM_EXECUTOR_H
+#define FSM_EXECUTOR_H
+
+#include <fsm/fsm.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace FSM {
+
+// What FSMExecutor::submit does when the queue of a shard is full.
+enum class Backpressure
+{
+    // Wait for a worker to make room.
+    Block,
+    // Discard the event and return false.
+    Drop
+};
+
+struct ExecutorOptions
+{
+    // Instances are spread over the shards by their identifier modulo the
+    // number of shards. A shard is processed by one worker at a time.
+    std::size_t shards = 64;
+    // Number of worker threads, 0 for one per hardware thread.
+    std::size_t threads = 0;
+    // Capacity of the event queue of every shard, rounded up to a power of
+    // two.
+    std::size_t queue_capacity = 1024;
+    // Number of events a worker processes from a shard before moving to the
+    // next one.
+    std::size_t batch_size = 64;
+    Backpressure backpressure = Backpressure::Block;
+};
+
+namespace detail {
+template <typename Machine>
+struct MachineBehavior;
+
+// Whether any transition of a machine has an action or a guard.
+template <typename StateType, typename Policy, typename... Transitions>
+struct MachineBehavior<BasicFSM<StateType, Policy, Transitions...>>
+    : AnyBehavior<Transitions...>
+{
+};
+
+// Event for an instance of a shard, by index.
+struct QueuedEvent
+{
+    std::uint32_t instance;
+    std::uint32_t event;
+};
+
+// Bounded lock-free queue accepting events from any number of threads and
+// consumed by one thread at a time, after Dmitry Vyukov's bounded queue.
+// Every cell holds a sequence number telling whether it is ready to be
+// written or read for a given position, so that producers only contend on
+// the position they increment.
+struct EventQueue
+{
+    explicit EventQueue(std::size_t capacity)
+        : mask_(round_up(capacity) - 1), cells_(new Cell[mask_ + 1])
+    {
+        for (std::size_t index = 0; index <= mask_; ++index)
+        {
+            cells_[index].sequence.store(index, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const QueuedEvent& event)
+    {
+        auto position = tail_.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& cell = cells_[position & mask_];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto difference =
+                std::intptr_t(sequence) - std::intptr_t(position);
+
+            if (difference == 0)
+            {
+                if (tail_.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.event = event;
+                    cell.sequence.store(
+                        position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Only one thread may pop at a time.
+    bool pop(QueuedEvent& event)
+    {
+        const auto position = head_.load(std::memory_order_relaxed);
+        auto& cell = cells_[position & mask_];
+
+        if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+        {
+            return false;
+        }
+
+        event = cell.event;
+        cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+        head_.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Whether an event is ready to be popped.
+    bool ready() const
+    {
+        const auto position = head_.load(std::memory_order_relaxed);
+        return cells_[position & mask_].sequence.load(
+                   std::memory_order_acquire)
+            == position + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        QueuedEvent event;
+    };
+
+    static std::size_t round_up(std::size_t capacity)
+    {
+        std::size_t result = 2;
+
+        while (result < capacity)
+        {
+            result *= 2;
+        }
+
+        return result;
+    }
+
+    const std::size_t mask_;
+    const std::unique_ptr<Cell[]> cells_;
+    // Producers and the consumer update different cache lines.
+    char cells_padding_[64];
+    std::atomic<std::size_t> tail_{0};
+    char tail_padding_[64];
+    std::atomic<std::size_t> head_{0};
+};
+} // namespace detail
+
+// Instances of a machine processing events submitted from any thread on a
+// pool of worker threads.
+// Instances are sharded by identifier, each shard having its own queue and
+// being processed by at most one worker at a time, so that the events of an
+// instance are processed in the order they were submitted. Workers start with
+// their own shards and move on to the others when they are idle.
+// Events are queued by index, see BasicFSM::process_id, so that machines
+// cannot have actions nor guards.
+template <typename Machine>
+struct FSMExecutor
+{
+    static_assert(
+        !detail::MachineBehavior<Machine>::value,
+        "the machines of an executor cannot have actions or guards");
+
+    // Throws std::invalid_argument if the options have no shard or an empty
+    // batch, or if a shard would hold more instances than can be queued.
+    FSMExecutor(
+        std::size_t size,
+        const Machine& initial,
+        const ExecutorOptions& options = ExecutorOptions())
+        : size_(size),
+          batch_size_(options.batch_size),
+          backpressure_(options.backpressure)
+    {
+        if (options.shards == 0 || options.batch_size == 0)
+        {
+            throw std::invalid_argument("executor needs shards and batches");
+        }
+
+        const auto shard_count = options.shards;
+
+        if (size / shard_count + (size % shard_count != 0) > UINT32_MAX)
+        {
+            throw std::invalid_argument("too many instances per shard");
+        }
+
+        for (std::size_t shard = 0; shard < shard_count; ++shard)
+        {
+            const auto instances = size / shard_count
+                + (shard < size % shard_count ? 1 : 0);
+            shards_.emplace_back(
+                new Shard(instances, initial, options.queue_capacity));
+        }
+
+        auto threads = options.threads;
+
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (std::size_t worker = 0; worker < threads; ++worker)
+        {
+            workers_.emplace_back([this, worker, threads] {
+                work(worker * shards_.size() / threads);
+            });
+        }
+    }
+
+    FSMExecutor(const FSMExecutor&) = delete;
+    FSMExecutor& operator=(const FSMExecutor&) = delete;
+
+    // Processes the events submitted so far before stopping the workers.
+    ~FSMExecutor()
+    {
+        drain();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_.store(true, std::memory_order_relaxed);
+        }
+
+        wake_.notify_all();
+
+        for (auto& worker : workers_)
+        {
+            worker.join();
+        }
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    // Queues an event for an instance.
+    // Returns false if the event was dropped because of backpressure.
+    template <typename Event>
+    bool submit(std::size_t instance, const Event&)
+    {
+        return submit_id(instance, Machine::template event_index<Event>());
+    }
+
+    // Throws std::out_of_range if the instance is not part of the executor
+    // or if the event index cannot be queued.
+    bool submit_id(std::size_t instance, std::size_t event_index)
+    {
+        if (instance >= size_)
+        {
+            throw std::out_of_range("instance out of range");
+        }
+
+        if (event_index > UINT32_MAX)
+        {
+            throw std::out_of_range("event index out of range");
+        }
+
+        const auto shard_count = shards_.size();
+        auto& shard = *shards_[instance % shard_count];
+        const detail::QueuedEvent event{
+            std::uint32_t(instance / shard_count),
+            std::uint32_t(event_index)};
+
+        while (!shard.queue.push(event))
+        {
+            if (backpressure_ == Backpressure::Drop)
+            {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            std::this_thread::yield();
+        }
+
+        // Pairs with the fence of sleep, so that either the worker sees the
+        // event or this thread sees the worker sleeping.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (sleepers_.load(std::memory_order_relaxed) != 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wake_.notify_one();
+        }
+
+        return true;
+    }
+
+    // Waits until the events submitted before the call are processed.
+    void drain() const
+    {
+        for (const auto& shard : shards_)
+        {
+            while (shard->queue.ready()
+                   || shard->claimed.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Instance of the executor, which may only be read while no event is
+    // pending for it, e.g. after drain.
+    const Machine& instance(std::size_t instance) const
+    {
+        const auto shard_count = shards_.size();
+        return shards_[instance % shard_count]
+            ->machines[instance / shard_count];
+    }
+
+    // Number of events dropped because of backpressure.
+    std::size_t dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Shard
+    {
+        Shard(std::size_t size, const Machine& initial, std::size_t capacity)
+            : machines(size, initial), queue(capacity)
+        {
+        }
+
+        std::vector<Machine> machines;
+        detail::EventQueue queue;
+        std::atomic<bool> claimed{false};
+    };
+
+    // Number of empty scans of the shards after which a worker sleeps.
+    static constexpr int idle_scans = 64;
+
+    void work(std::size_t first)
+    {
+        const auto shard_count = shards_.size();
+        int idle = 0;
+
+        while (!stopping_.load(std::memory_order_acquire))
+        {
+            bool found = false;
+
+            for (std::size_t offset = 0; offset < shard_count; ++offset)
+            {
+                found |= run(*shards_[(first + offset) % shard_count]);
+            }
+
+            if (found)
+            {
+                idle = 0;
+            }
+            else if (++idle < idle_scans)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                sleep();
+                idle = 0;
+            }
+        }
+    }
+
+    // Processes a batch of events of a shard unless another worker is
+    // processing it, and returns whether there were any.
+    bool run(Shard& shard)
+    {
+        if (!shard.queue.ready()
+            || shard.claimed.exchange(true, std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        detail::QueuedEvent event;
+        std::size_t count = 0;
+
+        while (count < batch_size_ && shard.queue.pop(event))
+        {
+            shard.machines[event.instance].process_id(event.event);
+            ++count;
+        }
+
+        shard.claimed.store(false, std::memory_order_release);
+        return count > 0;
+    }
+
+    bool ready() const
+    {
+        for (const auto& shard : shards_)
+        {
+            if (shard->queue.ready()) return true;
+        }
+
+        return false;
+    }
+
+    void sleep()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        sleepers_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!stopping_.load(std::memory_order_relaxed) && !ready())
+        {
+            wake_.wait(lock);
+        }
+
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    const std::size_t size_;
+    const std::size_t batch_size_;
+    const Backpressure backpressure_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<std::thread> workers_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<int> sleepers_{0};
+    std::atomic<std::size_t> dropped_{0};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+};
+
+template <typename Machine>
+constexpr int FSMExecutor<Machine>::idle_scans;
+}; // namespace FSM
+
+#endif
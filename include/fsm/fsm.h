@@ -1,12 +1,18 @@
 #ifndef FSM_H
 #define FSM_H
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <initializer_list>
-#include <iostream>
-#include <map>
-#include <memory>
+#include <ostream>
 #include <type_traits>
-#include <vector>
+#include <utility>
+
+#if __cplusplus >= 201703L
+#include <variant>
+#endif
 
 namespace FSM {
 
@@ -16,131 +22,1038 @@ struct VirtualTransition
     void operator()(const EventType&) {}
 };
 
+// Default action of a transition, doing nothing.
+struct NoAction
+{
+    template <typename EventType>
+    void operator()(const EventType&) const
+    {
+    }
+};
+
+// Default guard of a transition, always allowing it.
+struct NoGuard
+{
+    template <typename EventType>
+    constexpr bool operator()(const EventType&) const
+    {
+        return true;
+    }
+};
+
+// Adapts a function, such as a static member function, to be used as the
+// action or the guard of a transition.
+template <typename Function, Function function>
+struct Call
+{
+    template <typename EventType>
+    auto operator()(const EventType& event) const -> decltype(function(event))
+    {
+        return function(event);
+    }
+};
+
+// Transition from FromState to ToState when an event of type EventType
+// happens.
+// Action and Guard are default constructible callable types taking the event.
+// The transition only happens if the guard returns true, in which case the
+// action is invoked before the state changes.
 template <
     typename StateType,
     StateType FromState,
     typename EventType,
-    StateType ToState>
+    StateType ToState,
+    typename ActionType = NoAction,
+    typename GuardType = NoGuard>
 struct Transition : VirtualTransition<EventType>
 {
     using Event = EventType;
+    using Action = ActionType;
+    using Guard = GuardType;
     static const StateType from_state = FromState;
     static const StateType to_state = ToState;
+    static const bool has_behavior = !std::is_same<Action, NoAction>::value
+        || !std::is_same<Guard, NoGuard>::value;
+};
+
+// Whether any transition triggered by EventType has an action or a guard.
+template <typename EventType, typename... Transitions>
+struct HasBehavior
+    : std::integral_constant<
+          bool,
+          !std::is_same<
+              std::integer_sequence<
+                  bool,
+                  (std::is_same<typename Transitions::Event, EventType>::value
+                   && Transitions::has_behavior)...>,
+              std::integer_sequence<
+                  bool,
+                  (sizeof(Transitions*) == 0)...>>::value>
+{
+};
+
+// Whether any transition of a machine has an action or a guard.
+template <typename... Transitions>
+struct AnyBehavior
+    : std::integral_constant<
+          bool,
+          !std::is_same<
+              std::integer_sequence<bool, Transitions::has_behavior...>,
+              std::integer_sequence<
+                  bool,
+                  (sizeof(Transitions*) == 0)...>>::value>
+{
 };
 
-template <class Function, std::size_t... Indices>
-constexpr auto make_array_helper(Function f, std::index_sequence<Indices...>)
-    -> std::array<
-        typename std::result_of<Function(std::size_t)>::type,
-        sizeof...(Indices)>
+namespace detail {
+template <typename Transition, typename StateType, typename EventType>
+bool fire(StateType&, const EventType&, std::false_type)
 {
-    return {{f(Indices)...}};
+    return false;
 }
 
-template <int N, class Function>
-constexpr auto make_array(Function f)
-    -> std::array<typename std::result_of<Function(std::size_t)>::type, N>
+template <typename Transition, typename StateType, typename EventType>
+bool fire(StateType& state, const EventType& event, std::true_type)
 {
-    return make_array_helper(f, std::make_index_sequence<N>{});
+    if (state == Transition::from_state
+        && typename Transition::Guard{}(event))
+    {
+        typename Transition::Action{}(event);
+        state = Transition::to_state;
+        return true;
+    }
+
+    return false;
 }
 
-template <typename StateType, typename EventType, typename... Transitions>
-constexpr std::underlying_type_t<StateType> MaxState()
+// Minimal array usable as a compile-time buffer, std::array lacking constexpr
+// mutable accessors in C++14.
+template <typename Value, std::size_t Size>
+struct ConstArray
 {
-    return std::max({Transitions::from_state...});
+    constexpr Value& operator[](const std::size_t index)
+    {
+        return values[index];
+    }
+
+    constexpr const Value& operator[](const std::size_t index) const
+    {
+        return values[index];
+    }
+
+    Value values[Size > 0 ? Size : 1];
+};
+
+template <typename Value, std::size_t Size, std::size_t... Indices>
+constexpr std::array<Value, Size> to_array(
+    const ConstArray<Value, Size>& values,
+    std::index_sequence<Indices...>)
+{
+    return {{values[Indices]...}};
 }
 
-template <typename StateType, typename EventType, typename... Transitions>
-struct TransitionHelper;
+// Index of the first true value, or the number of values if there is none.
+constexpr std::size_t first_of(std::initializer_list<bool> values)
+{
+    std::size_t index = 0;
 
-namespace detail {
+    for (const bool value : values)
+    {
+        if (value) break;
+        ++index;
+    }
+
+    return index;
+}
+
+// Destination states of the transitions triggered by an event, indexed by
+// origin state, built in a single pass over the transitions.
+// Transitions are visited backwards so that the first of several transitions
+// leaving the same state takes precedence, and transitions leaving states
+// beyond the table are ignored.
 template <
+    typename Value,
+    std::size_t Size,
     typename StateType,
     typename EventType,
-    typename Transition,
     typename... Transitions>
-std::array<
+constexpr ConstArray<Value, Size> transition_table()
+{
+    constexpr bool matches[] = {
+        false, std::is_same<typename Transitions::Event, EventType>::value...};
+    constexpr std::size_t from[] = {
+        0, std::size_t(Transitions::from_state)...};
+    constexpr std::size_t to[] = {0, std::size_t(Transitions::to_state)...};
+
+    ConstArray<Value, Size> result{};
+
+    for (std::size_t state = 0; state < Size; ++state)
+    {
+        result[state] = Value(state);
+    }
+
+    for (std::size_t index = sizeof...(Transitions); index > 0; --index)
+    {
+        if (matches[index] && from[index] < Size)
+        {
+            result[from[index]] = Value(to[index]);
+        }
+    }
+
+    return result;
+}
+} // namespace detail
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr std::underlying_type_t<StateType> MaxState()
+{
+    return std::max(
+        {std::is_same<typename Transitions::Event, EventType>::value
+             ? std::underlying_type_t<StateType>(Transitions::from_state)
+             : std::underlying_type_t<StateType>(0)...});
+}
+
+template <typename StateType, typename... Transitions>
+constexpr std::size_t StateCount()
+{
+    return std::size_t(std::max(
+               {std::underlying_type_t<StateType>(Transitions::from_state)...,
+                std::underlying_type_t<StateType>(Transitions::to_state)...}))
+        + 1;
+}
+
+template <std::size_t Count>
+struct NarrowStateHelper
+{
+    using type = std::conditional_t<
+        Count <= (std::size_t(1) << 8),
+        std::uint8_t,
+        std::conditional_t<
+            Count <= (std::size_t(1) << 16),
+            std::uint16_t,
+            std::uint32_t>>;
+};
+
+// Smallest unsigned integer type able to hold every state of a machine.
+template <typename StateType, typename... Transitions>
+using NarrowState = typename NarrowStateHelper<
+    StateCount<StateType, Transitions...>()>::type;
+
+// Table of the transitions triggered by an event, indexed by origin state.
+// It is built at compile time and stored as constant data, so that looking up
+// a transition never involves any initialization at runtime.
+template <typename StateType, typename EventType, typename... Transitions>
+struct TransitionTable
+{
+    static constexpr std::size_t size =
+        std::size_t(MaxState<StateType, EventType, Transitions...>()) + 1;
+
+    static constexpr std::array<StateType, size> value = detail::to_array(
+        detail::transition_table<
+            StateType,
+            size,
+            StateType,
+            EventType,
+            Transitions...>(),
+        std::make_index_sequence<size>{});
+};
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr std::array<
     StateType,
-    std::size_t(MaxState<StateType, EventType, Transitions...>() + 1)>
-transitions()
-{
-    using TransitionHelper_ =
-        TransitionHelper<StateType, EventType, Transition, Transitions...>;
-    static std::array<
-        StateType,
-        std::size_t(MaxState<StateType, EventType, Transitions...>() + 1)>
-        transition_array = make_array<std::size_t(
-            MaxState<StateType, EventType, Transitions...>() + 1)>(
-            TransitionHelper_::getToState);
-    return transition_array;
+    TransitionTable<StateType, EventType, Transitions...>::size>
+    TransitionTable<StateType, EventType, Transitions...>::value;
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr const auto& transitions =
+    TransitionTable<StateType, EventType, Transitions...>::value;
+
+template <typename... Types>
+struct TypeList
+{
+    static constexpr std::size_t size = sizeof...(Types);
+};
+
+namespace detail {
+template <std::size_t Index, typename Type>
+struct Indexed
+{
+    using type = Type;
+};
+
+template <typename Sequence, typename... Types>
+struct Indexer;
+
+template <std::size_t... Indices, typename... Types>
+struct Indexer<std::index_sequence<Indices...>, Types...>
+    : Indexed<Indices, Types>...
+{
+};
+
+template <std::size_t Index, typename Type>
+Indexed<Index, Type> select(const Indexed<Index, Type>&);
+
+constexpr std::size_t count_first_occurrences(
+    std::initializer_list<std::size_t> firsts)
+{
+    std::size_t count = 0;
+    std::size_t index = 0;
+
+    for (const auto first : firsts)
+    {
+        if (first == index++) ++count;
+    }
+
+    return count;
+}
+
+// Indices of the values equal to their own index.
+template <std::size_t Count>
+constexpr ConstArray<std::size_t, Count> first_occurrences(
+    std::initializer_list<std::size_t> firsts)
+{
+    ConstArray<std::size_t, Count> result{};
+    std::size_t count = 0;
+    std::size_t index = 0;
+
+    for (const auto first : firsts)
+    {
+        if (first == index) result[count++] = index;
+        ++index;
+    }
+
+    return result;
 }
 } // namespace detail
 
-template <
-    typename StateType,
-    typename EventType,
-    typename Transition,
-    typename... Transitions>
-static const auto& transitions =
-    detail::transitions<StateType, EventType, Transition, Transitions...>();
+// Type at an index of a pack.
+// It is found by overload resolution rather than by recursion, so that it
+// scales to long packs.
+template <std::size_t Index, typename... Types>
+using TypeAt = typename decltype(detail::select<Index>(
+    std::declval<
+        detail::Indexer<std::index_sequence_for<Types...>, Types...>>()))::type;
+
+template <typename List, typename Type>
+struct IndexOf;
+
+// Index of the first occurrence of a type in a list, or the size of the list
+// if it does not contain it.
+template <typename... Types, typename Type>
+struct IndexOf<TypeList<Types...>, Type>
+    : std::integral_constant<
+          std::size_t,
+          detail::first_of({std::is_same<Types, Type>::value...})>
+{
+};
+
+// Types of a list without duplicates, in order of first appearance.
+// Each distinct type is compared once to every type of the list, so the cost
+// grows with the number of distinct types times the size of the list.
+// The list is given both as a type and as a pack, so that it is not formed
+// again for every type of the pack.
+template <typename List, typename... Types>
+struct UniqueHelper
+{
+    static constexpr std::size_t count =
+        detail::count_first_occurrences({IndexOf<List, Types>::value...});
 
+    static constexpr detail::ConstArray<std::size_t, count> positions =
+        detail::first_occurrences<count>({IndexOf<List, Types>::value...});
+
+    template <typename Sequence>
+    struct Apply;
+
+    template <std::size_t... Indices>
+    struct Apply<std::index_sequence<Indices...>>
+    {
+        using type = TypeList<TypeAt<positions[Indices], Types...>...>;
+    };
+
+    using type = typename Apply<std::make_index_sequence<count>>::type;
+};
+
+template <typename List, typename... Types>
+constexpr detail::ConstArray<
+    std::size_t,
+    UniqueHelper<List, Types...>::count>
+    UniqueHelper<List, Types...>::positions;
+
+template <typename... Types>
+using Unique = UniqueHelper<TypeList<Types...>, Types...>;
+
+template <template <typename...> class Template, typename List>
+struct EventsAs;
+
+template <template <typename...> class Template, typename... Types>
+struct EventsAs<Template, TypeList<Types...>>
+{
+    using type = Template<Types...>;
+};
+
+// Event types of a machine, without duplicates, in order of first appearance.
+template <typename... Transitions>
+using EventList = typename Unique<typename Transitions::Event...>::type;
+
+namespace detail {
+// Destination states of the transitions of a machine, indexed by origin state
+// and event, built in a single pass over the transitions.
 template <
-    typename StateType,
-    typename EventType,
-    typename Transition,
+    typename Value,
+    std::size_t StateCount,
+    typename Events,
     typename... Transitions>
-struct TransitionHelper<StateType, EventType, Transition, Transitions...>
+constexpr ConstArray<Value, StateCount * Events::size> event_table()
 {
-    static constexpr StateType getToState(const std::size_t from_state)
+    constexpr std::size_t event_count = Events::size;
+    constexpr std::size_t events[] = {
+        0, IndexOf<Events, typename Transitions::Event>::value...};
+    constexpr std::size_t from[] = {
+        0, std::size_t(Transitions::from_state)...};
+    constexpr std::size_t to[] = {0, std::size_t(Transitions::to_state)...};
+
+    ConstArray<Value, StateCount * event_count> result{};
+
+    for (std::size_t state = 0; state < StateCount; ++state)
     {
-        if (std::is_same<typename Transition::Event, EventType>()
-            && StateType(from_state) == Transition::from_state)
+        for (std::size_t event = 0; event < event_count; ++event)
         {
-            return Transition::to_state;
+            result[state * event_count + event] = Value(state);
         }
-        else
+    }
+
+    for (std::size_t index = sizeof...(Transitions); index > 0; --index)
+    {
+        result[from[index] * event_count + events[index]] = Value(to[index]);
+    }
+
+    return result;
+}
+} // namespace detail
+
+// Table of the transitions of a machine for every event, flattened so that
+// the transition triggered by event E in state S is at S * event count + E.
+// Events are numbered by their order of first appearance in the transitions.
+// States are stored using the narrowest integer type able to hold them.
+template <typename StateType, typename... Transitions>
+struct EventTable
+{
+    using Events = EventList<Transitions...>;
+    using Narrow = NarrowState<StateType, Transitions...>;
+
+    static constexpr std::size_t state_count =
+        StateCount<StateType, Transitions...>();
+    static constexpr std::size_t event_count = Events::size;
+    static constexpr std::size_t size = state_count * event_count;
+
+    static constexpr std::array<Narrow, size> value = detail::to_array(
+        detail::event_table<Narrow, state_count, Events, Transitions...>(),
+        std::make_index_sequence<size>{});
+};
+
+template <typename StateType, typename... Transitions>
+constexpr std::array<
+    typename EventTable<StateType, Transitions...>::Narrow,
+    EventTable<StateType, Transitions...>::size>
+    EventTable<StateType, Transitions...>::value;
+
+namespace detail {
+// Whether a transition of a machine leaves a state on an event, indexed like
+// event_table.
+template <std::size_t StateCount, typename Events, typename... Transitions>
+constexpr ConstArray<bool, StateCount * Events::size> accepting_table()
+{
+    constexpr std::size_t event_count = Events::size;
+    constexpr std::size_t events[] = {
+        0, IndexOf<Events, typename Transitions::Event>::value...};
+    constexpr std::size_t from[] = {
+        0, std::size_t(Transitions::from_state)...};
+
+    ConstArray<bool, StateCount * event_count> result{};
+
+    for (std::size_t index = sizeof...(Transitions); index > 0; --index)
+    {
+        result[from[index] * event_count + events[index]] = true;
+    }
+
+    return result;
+}
+} // namespace detail
+
+// Table telling apart the events triggering a transition, self transitions
+// included, from those left unhandled, laid out like EventTable.
+// It is only used by instrumented machines, which cannot tell them apart from
+// the destination states alone.
+template <typename StateType, typename... Transitions>
+struct AcceptTable
+{
+    using Events = EventList<Transitions...>;
+
+    static constexpr std::size_t state_count =
+        StateCount<StateType, Transitions...>();
+    static constexpr std::size_t event_count = Events::size;
+    static constexpr std::size_t size = state_count * event_count;
+
+    static constexpr std::array<bool, size> value = detail::to_array(
+        detail::accepting_table<state_count, Events, Transitions...>(),
+        std::make_index_sequence<size>{});
+
+    static bool accepts(const std::size_t state, const std::size_t event)
+    {
+        return state < state_count && event < event_count
+            && value[state * event_count + event];
+    }
+};
+
+template <typename StateType, typename... Transitions>
+constexpr std::array<bool, AcceptTable<StateType, Transitions...>::size>
+    AcceptTable<StateType, Transitions...>::value;
+
+namespace detail {
+inline int popcount(const std::uint64_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(word);
+#else
+    auto count = 0;
+    for (auto bits = word; bits; bits &= bits - 1) ++count;
+    return count;
+#endif
+}
+
+// Number of states whose entry in a dense table is not themselves.
+template <typename Table>
+constexpr std::size_t count_transitions()
+{
+    std::size_t count = 0;
+
+    for (std::size_t state = 0; state < Table::size; ++state)
+    {
+        if (std::size_t(Table::value[state]) != state) ++count;
+    }
+
+    return count;
+}
+
+template <typename Narrow, typename Table>
+constexpr ConstArray<Narrow, Table::size> narrow_table()
+{
+    ConstArray<Narrow, Table::size> result{};
+
+    for (std::size_t state = 0; state < Table::size; ++state)
+    {
+        result[state] = Narrow(Table::value[state]);
+    }
+
+    return result;
+}
+
+// Origin or destination states of the transitions of a dense table, sorted
+// by origin state.
+template <typename Narrow, typename Table, std::size_t Count>
+constexpr ConstArray<Narrow, Count> sparse_table(const bool destinations)
+{
+    ConstArray<Narrow, Count> result{};
+    std::size_t count = 0;
+
+    for (std::size_t state = 0; state < Table::size; ++state)
+    {
+        if (std::size_t(Table::value[state]) != state)
+        {
+            result[count++] =
+                Narrow(destinations ? std::size_t(Table::value[state]) : state);
+        }
+    }
+
+    return result;
+}
+
+// One bit per state of a dense table, set for states having a transition.
+template <typename Table, std::size_t Words>
+constexpr ConstArray<std::uint64_t, Words> bitmap_table()
+{
+    ConstArray<std::uint64_t, Words> result{};
+
+    for (std::size_t state = 0; state < Table::size; ++state)
+    {
+        if (std::size_t(Table::value[state]) != state)
         {
-            return TransitionHelper<
-                StateType, EventType, Transitions...>::getToState(from_state);
+            result[state / 64] |= std::uint64_t(1) << (state % 64);
         }
     }
+
+    return result;
+}
+
+// Number of states having a transition before each word of a bitmap.
+template <typename Rank, typename Table, std::size_t Words>
+constexpr ConstArray<Rank, Words> rank_table()
+{
+    ConstArray<Rank, Words> result{};
+    std::size_t count = 0;
+
+    for (std::size_t state = 0; state < Table::size; ++state)
+    {
+        if (state % 64 == 0) result[state / 64] = Rank(count);
+        if (std::size_t(Table::value[state]) != state) ++count;
+    }
+
+    return result;
+}
+} // namespace detail
+
+// Layouts of the table of the transitions triggered by an event.
+// Each provides lookup, which returns the destination state of an origin
+// state, or the origin state itself when it has no transition.
+
+// Array of destination states indexed by origin state.
+template <typename StateType, typename EventType, typename... Transitions>
+struct DenseTable
+{
+    using Source = TransitionTable<StateType, EventType, Transitions...>;
+    using Narrow = NarrowState<StateType, Transitions...>;
+
+    static constexpr std::size_t size = Source::size;
+    static constexpr std::size_t bytes = size * sizeof(Narrow);
+
+    static constexpr detail::ConstArray<Narrow, size> value =
+        detail::narrow_table<Narrow, Source>();
+
+    static constexpr const char* name()
+    {
+        return "dense";
+    }
+
+    static std::size_t lookup(const std::size_t state)
+    {
+        return state < size ? value[state] : state;
+    }
 };
 
-template <typename StateType, typename EventType>
-struct TransitionHelper<StateType, EventType>
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr detail::ConstArray<
+    typename DenseTable<StateType, EventType, Transitions...>::Narrow,
+    DenseTable<StateType, EventType, Transitions...>::size>
+    DenseTable<StateType, EventType, Transitions...>::value;
+
+// Origin and destination states of the transitions, sorted by origin state and
+// searched by bisection.
+template <typename StateType, typename EventType, typename... Transitions>
+struct SparseTable
 {
-    static constexpr StateType getToState(const std::size_t from_state)
+    using Source = TransitionTable<StateType, EventType, Transitions...>;
+    using Narrow = NarrowState<StateType, Transitions...>;
+
+    static constexpr std::size_t count = detail::count_transitions<Source>();
+    static constexpr std::size_t bytes = 2 * count * sizeof(Narrow);
+
+    static constexpr detail::ConstArray<Narrow, count> from =
+        detail::sparse_table<Narrow, Source, count>(false);
+    static constexpr detail::ConstArray<Narrow, count> to =
+        detail::sparse_table<Narrow, Source, count>(true);
+
+    static constexpr const char* name()
     {
-        return StateType(from_state);
+        return "sparse";
+    }
+
+    static std::size_t lookup(const std::size_t state)
+    {
+        std::size_t first = 0;
+        std::size_t last = count;
+
+        while (first < last)
+        {
+            const auto middle = first + (last - first) / 2;
+
+            if (from[middle] < state)
+            {
+                first = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+
+        return first < count && from[first] == state ? to[first] : state;
     }
 };
 
-template <typename StateType, typename... Transitions>
-struct FSM
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr detail::ConstArray<
+    typename SparseTable<StateType, EventType, Transitions...>::Narrow,
+    SparseTable<StateType, EventType, Transitions...>::count>
+    SparseTable<StateType, EventType, Transitions...>::from;
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr detail::ConstArray<
+    typename SparseTable<StateType, EventType, Transitions...>::Narrow,
+    SparseTable<StateType, EventType, Transitions...>::count>
+    SparseTable<StateType, EventType, Transitions...>::to;
+
+// Bitmap of the origin states having a transition, along with the number of
+// such states before each word of the bitmap, used to find the destination
+// state among those of the transitions sorted by origin state.
+template <typename StateType, typename EventType, typename... Transitions>
+struct BitmapTable
+{
+    using Source = TransitionTable<StateType, EventType, Transitions...>;
+    using Narrow = NarrowState<StateType, Transitions...>;
+
+    static constexpr std::size_t size = Source::size;
+    static constexpr std::size_t count = detail::count_transitions<Source>();
+    static constexpr std::size_t words = (size + 63) / 64;
+
+    using Rank = typename NarrowStateHelper<count + 1>::type;
+
+    static constexpr std::size_t bytes =
+        words * (sizeof(std::uint64_t) + sizeof(Rank)) + count * sizeof(Narrow);
+
+    static constexpr detail::ConstArray<std::uint64_t, words> bitmap =
+        detail::bitmap_table<Source, words>();
+    static constexpr detail::ConstArray<Rank, words> ranks =
+        detail::rank_table<Rank, Source, words>();
+    static constexpr detail::ConstArray<Narrow, count> to =
+        detail::sparse_table<Narrow, Source, count>(true);
+
+    static constexpr const char* name()
+    {
+        return "bitmap";
+    }
+
+    static std::size_t lookup(const std::size_t state)
+    {
+        if (state >= size) return state;
+
+        const auto word = bitmap[state / 64];
+        const auto bit = std::uint64_t(1) << (state % 64);
+
+        if (!(word & bit)) return state;
+
+        return to[ranks[state / 64] + detail::popcount(word & (bit - 1))];
+    }
+};
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr detail::ConstArray<
+    std::uint64_t,
+    BitmapTable<StateType, EventType, Transitions...>::words>
+    BitmapTable<StateType, EventType, Transitions...>::bitmap;
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr detail::ConstArray<
+    typename BitmapTable<StateType, EventType, Transitions...>::Rank,
+    BitmapTable<StateType, EventType, Transitions...>::words>
+    BitmapTable<StateType, EventType, Transitions...>::ranks;
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr detail::ConstArray<
+    typename BitmapTable<StateType, EventType, Transitions...>::Narrow,
+    BitmapTable<StateType, EventType, Transitions...>::count>
+    BitmapTable<StateType, EventType, Transitions...>::to;
+
+// Chooses the layout of the table of the transitions triggered by an event.
+// The dense layout is the fastest, so it is kept as long as it fits in a cache
+// line or is no more than twice as large as the smallest other layout.
+template <typename StateType, typename EventType, typename... Transitions>
+struct TableLayout
 {
-    template <StateType FromState, typename EventType, StateType ToState>
-    using Transition = Transition<StateType, FromState, EventType, ToState>;
+    using Dense = DenseTable<StateType, EventType, Transitions...>;
+    using Sparse = SparseTable<StateType, EventType, Transitions...>;
+    using Bitmap = BitmapTable<StateType, EventType, Transitions...>;
+
+    static constexpr std::size_t compressed_bytes =
+        std::min(Sparse::bytes, Bitmap::bytes);
+
+    using type = std::conditional_t<
+        Dense::bytes <= 64 || Dense::bytes <= 2 * compressed_bytes,
+        Dense,
+        std::conditional_t<Sparse::bytes <= Bitmap::bytes, Sparse, Bitmap>>;
+};
 
-    FSM(StateType initial_state) : state_(initial_state) {}
+template <typename StateType, typename EventType, typename... Transitions>
+using CompressedTable =
+    typename TableLayout<StateType, EventType, Transitions...>::type;
 
+// Instrumentation policy of machines that are not instrumented.
+// A policy provides an Instance template, instantiated with the numbers of
+// states and events of a machine and stored in every instance of it. When the
+// policy is enabled, every processed event is reported to its on_transition or
+// on_reject member function, see fsm/instrumentation.h.
+struct NoInstrumentation
+{
+    static constexpr bool enabled = false;
+
+    template <std::size_t StateCount, std::size_t EventCount>
+    struct Instance
+    {
+    };
+};
+
+template <typename StateType, typename Policy, typename... Transitions>
+struct BasicFSM
+    : private Policy::template Instance<
+          StateCount<StateType, Transitions...>(),
+          EventList<Transitions...>::size>
+{
+    template <
+        StateType FromState,
+        typename EventType,
+        StateType ToState,
+        typename Action = NoAction,
+        typename Guard = NoGuard>
+    using Transition =
+        Transition<StateType, FromState, EventType, ToState, Action, Guard>;
+
+    using Instruments = typename Policy::template Instance<
+        StateCount<StateType, Transitions...>(),
+        EventList<Transitions...>::size>;
+
+    BasicFSM(StateType initial_state) : state_(initial_state) {}
+
+    // Events whose transitions have neither action nor guard are processed
+    // with a table lookup, others with a chain of comparisons against the
+    // origin states of their transitions.
+    template <typename Event>
+    StateType process(const Event& event)
+    {
+        return process(
+            event, HasBehavior<Event, Transitions...>{}, Instrumented{});
+    }
+
+    using Events = EventList<Transitions...>;
+
+    // Instantiates a template with the event types of this machine, in the
+    // order defining their indices, e.g. events_as<std::variant>.
+    template <template <typename...> class Template>
+    using events_as = typename EventsAs<Template, Events>::type;
+
+    static constexpr std::size_t event_count = Events::size;
+
+    // Index of an event type, as accepted by process_id.
+    // Event types triggering no transition get event_count.
     template <typename Event>
-    StateType process(const Event&)
+    static constexpr std::size_t event_index()
+    {
+        return IndexOf<Events, Event>::value;
+    }
+
+    // Process an event known by its index rather than by its type.
+    // Indices out of range are ignored.
+    // Only machines without actions nor guards can do so, as those need the
+    // event itself.
+    StateType process_id(const std::size_t event_index)
+    {
+        static_assert(
+            !AnyBehavior<Transitions...>::value,
+            "machines with actions or guards cannot process events by index");
+
+        return process_id(event_index, Instrumented{});
+    }
+
+    // State of the instrumentation policy, holding what it recorded.
+    const Instruments& instruments() const
+    {
+        return *this;
+    }
+
+    // Size in bytes of the tables used by process for every event, of the
+    // table used by process_id and, for instrumented machines, of the table
+    // telling apart unhandled events.
+    static constexpr std::size_t table_bytes()
+    {
+        return table_bytes(Events{}) + index_table_bytes + accept_table_bytes;
+    }
+
+    // Writes the layout and the size of every table.
+    static void report(std::ostream& stream)
     {
-        const auto state_as_underlying_type =
-            static_cast<std::underlying_type_t<StateType>>(state_);
+        report(stream, Events{});
+        stream << "index table: " << index_table_bytes << " bytes\n";
 
-        if (MaxState<StateType, Event, Transitions...>()
-            >= state_as_underlying_type)
+        if (Instrumented::value)
         {
-            state_ = transitions<
-                StateType, Event, Transitions...>[state_as_underlying_type];
+            stream << "accept table: " << accept_table_bytes << " bytes\n";
         }
 
-        return state_;
+        stream << "total: " << table_bytes() << " bytes\n";
+    }
+
+#if __cplusplus >= 201703L
+    template <typename... Alternatives>
+    StateType process(const std::variant<Alternatives...>& event)
+    {
+        if constexpr (AnyBehavior<Transitions...>::value)
+        {
+            return std::visit(
+                [this](const auto& alternative) {
+                    return process(alternative);
+                },
+                event);
+        }
+        else
+        {
+            static constexpr std::size_t indices[] = {
+                event_index<Alternatives>()...};
+
+            if (event.valueless_by_exception())
+            {
+                return state_;
+            }
+
+            return process_id(indices[event.index()]);
+        }
     }
+#endif
 
     StateType state_;
+
+private:
+    using Instrumented = std::integral_constant<bool, Policy::enabled>;
+
+    // Sizes of EventTable and AcceptTable, computed without instantiating
+    // them.
+    static constexpr std::size_t index_table_bytes =
+        StateCount<StateType, Transitions...>() * event_count
+        * sizeof(NarrowState<StateType, Transitions...>);
+    static constexpr std::size_t accept_table_bytes = Instrumented::value
+        ? StateCount<StateType, Transitions...>() * event_count * sizeof(bool)
+        : 0;
+
+    template <typename Event>
+    StateType process(const Event&, std::false_type, std::false_type)
+    {
+        using Table = CompressedTable<StateType, Event, Transitions...>;
+
+        state_ = StateType(Table::lookup(std::size_t(state_)));
+        return state_;
+    }
+
+    template <typename Event>
+    StateType process(const Event&, std::false_type, std::true_type)
+    {
+        using Table = CompressedTable<StateType, Event, Transitions...>;
+
+        const auto from = std::size_t(state_);
+        state_ = StateType(Table::lookup(from));
+        notify(from, event_index<Event>(), std::true_type{});
+        return state_;
+    }
+
+    void notify(std::size_t, std::size_t, std::false_type) {}
+
+    void notify(std::size_t from, std::size_t event, std::true_type)
+    {
+        notify(
+            from,
+            event,
+            AcceptTable<StateType, Transitions...>::accepts(from, event),
+            std::true_type{});
+    }
+
+    void notify(std::size_t, std::size_t, bool, std::false_type) {}
+
+    void notify(
+        std::size_t from,
+        std::size_t event,
+        bool accepted,
+        std::true_type)
+    {
+        Instruments& instruments = *this;
+
+        if (accepted)
+        {
+            instruments.on_transition(from, event, std::size_t(state_));
+        }
+        else
+        {
+            instruments.on_reject(from, std::min(event, event_count));
+        }
+    }
+
+    template <typename... Events>
+    static constexpr std::size_t table_bytes(TypeList<Events...>)
+    {
+        std::size_t bytes = 0;
+        const std::size_t expanded[] = {
+            bytes,
+            (bytes += CompressedTable<StateType, Events, Transitions...>::
+                 bytes)...};
+        (void)expanded;
+        return bytes;
+    }
+
+    template <typename... Events>
+    static void report(std::ostream& stream, TypeList<Events...>)
+    {
+        const bool expanded[] = {
+            true,
+            (stream << "event " << event_index<Events>() << ": "
+                    << CompressedTable<StateType, Events, Transitions...>::
+                           name()
+                    << " table, "
+                    << CompressedTable<StateType, Events, Transitions...>::
+                           bytes
+                    << " bytes\n",
+             true)...};
+        (void)expanded;
+    }
+
+    template <typename Event, typename Instrumentation>
+    StateType process(const Event& event, std::true_type, Instrumentation)
+    {
+        const auto from = std::size_t(state_);
+        bool fired = false;
+        const bool expanded[] = {
+            fired,
+            (fired = fired
+                 || detail::fire<Transitions>(
+                        state_,
+                        event,
+                        std::is_same<typename Transitions::Event, Event>{}))
+                ...};
+        (void)expanded;
+        notify(from, event_index<Event>(), fired, Instrumentation{});
+
+        return state_;
+    }
+
+    StateType process_id(const std::size_t event_index, std::false_type)
+    {
+        using Table = EventTable<StateType, Transitions...>;
+
+        const auto index = std::size_t(state_);
+
+        if (index < Table::state_count && event_index < Table::event_count)
+        {
+            state_ = StateType(
+                Table::value[index * Table::event_count + event_index]);
+        }
+
+        return state_;
+    }
+
+    StateType process_id(const std::size_t event_index, std::true_type)
+    {
+        const auto from = std::size_t(state_);
+        process_id(event_index, std::false_type{});
+        notify(from, event_index, std::true_type{});
+
+        return state_;
+    }
 };
+
+template <typename StateType, typename Policy, typename... Transitions>
+constexpr std::size_t
+    BasicFSM<StateType, Policy, Transitions...>::index_table_bytes;
+
+template <typename StateType, typename Policy, typename... Transitions>
+constexpr std::size_t
+    BasicFSM<StateType, Policy, Transitions...>::accept_table_bytes;
+
+template <typename StateType, typename... Transitions>
+using FSM = BasicFSM<StateType, NoInstrumentation, Transitions...>;
 }; // namespace FSM
 
 #endif
@@ -0,0 +1,314 @@
+#ifndef FSM_INSTRUMENTATION_H
+#define FSM_INSTRUMENTATION_H
+
+#include <fsm/fsm.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace FSM {
+
+// Instrumentation policies of BasicFSM.
+// Each of them can be used alone or combined with others by Instrumentation.
+// Their Instance templates receive, after every processed event, the origin
+// state, the index of the event as returned by event_index, and the
+// destination state, through on_transition when a transition fired or through
+// on_reject otherwise. Events unknown to the machine have index EventCount.
+// States beyond the transitions of the machine are not recorded.
+
+// Clock reading std::chrono::steady_clock, in nanoseconds on most platforms.
+struct SteadyClock
+{
+    static std::uint64_t now()
+    {
+        return std::uint64_t(
+            std::chrono::steady_clock::now().time_since_epoch().count());
+    }
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+// Clock reading the time stamp counter, in cycles of a constant frequency on
+// recent processors.
+// It is cheaper than SteadyClock but not synchronized between cores on every
+// machine.
+struct TscClock
+{
+    static std::uint64_t now()
+    {
+        return __rdtsc();
+    }
+};
+#endif
+
+// Number of times every transition fired, by origin state and event.
+struct TransitionCounters
+{
+    static constexpr bool enabled = true;
+
+    template <std::size_t StateCount, std::size_t EventCount>
+    struct Instance
+    {
+        void on_transition(std::size_t from, std::size_t event, std::size_t)
+        {
+            if (from < StateCount) ++counts_[from * EventCount + event];
+        }
+
+        void on_reject(std::size_t, std::size_t) {}
+
+        std::uint64_t transition_count(std::size_t state, std::size_t event)
+            const
+        {
+            return counts_[state * EventCount + event];
+        }
+
+    private:
+        std::array<std::uint64_t, StateCount * EventCount> counts_{};
+    };
+};
+
+// Number of events triggering no transition, by state and event.
+struct RejectionCounters
+{
+    static constexpr bool enabled = true;
+
+    template <std::size_t StateCount, std::size_t EventCount>
+    struct Instance
+    {
+        void on_transition(std::size_t, std::size_t, std::size_t) {}
+
+        void on_reject(std::size_t state, std::size_t event)
+        {
+            if (state < StateCount) ++counts_[state * (EventCount + 1) + event];
+        }
+
+        std::uint64_t rejection_count(std::size_t state, std::size_t event)
+            const
+        {
+            return counts_[state * (EventCount + 1) + event];
+        }
+
+    private:
+        std::array<std::uint64_t, StateCount * (EventCount + 1)> counts_{};
+    };
+};
+
+namespace detail {
+// Number of bits needed to write a value, 0 for 0.
+inline std::size_t bit_width(std::uint64_t value)
+{
+#if defined(__GNUC__)
+    return value == 0 ? 0 : 64 - std::size_t(__builtin_clzll(value));
+#else
+    std::size_t width = 0;
+
+    for (; value != 0; value >>= 1)
+    {
+        ++width;
+    }
+
+    return width;
+#endif
+}
+} // namespace detail
+
+// Time spent in every state before leaving it, as histograms with buckets of
+// exponentially growing widths: bucket 0 counts stays of no tick, bucket B
+// stays from 2^(B-1) to 2^B - 1 ticks of Clock, and the last bucket every
+// longer stay.
+// Self transitions count as leaving the state.
+template <typename Clock = SteadyClock, std::size_t Buckets = 32>
+struct DwellTimeHistograms
+{
+    static_assert(Buckets > 0, "histograms need at least one bucket");
+
+    static constexpr bool enabled = true;
+
+    using Histogram = std::array<std::uint64_t, Buckets>;
+
+    template <std::size_t StateCount, std::size_t EventCount>
+    struct Instance
+    {
+        Instance() : entered_(Clock::now()) {}
+
+        void on_transition(std::size_t from, std::size_t, std::size_t)
+        {
+            const auto now = Clock::now();
+
+            if (from < StateCount)
+            {
+                const auto bucket = detail::bit_width(now - entered_);
+                ++histograms_[from][bucket < Buckets ? bucket : Buckets - 1];
+            }
+
+            entered_ = now;
+        }
+
+        void on_reject(std::size_t, std::size_t) {}
+
+        const Histogram& dwell_histogram(std::size_t state) const
+        {
+            return histograms_[state];
+        }
+
+    private:
+        std::uint64_t entered_;
+        std::array<Histogram, StateCount> histograms_{};
+    };
+};
+
+template <typename Clock, std::size_t Buckets>
+constexpr bool DwellTimeHistograms<Clock, Buckets>::enabled;
+
+// Transition recorded by a TraceBuffer, sequence being its rank among all the
+// transitions of the machine, starting at 1.
+struct TraceRecord
+{
+    std::uint64_t sequence;
+    std::uint32_t from;
+    std::uint32_t event;
+    std::uint32_t to;
+};
+
+// Ring buffer of the last Capacity transitions.
+// It is written by the thread processing the events, and can be read
+// concurrently without locks from any other thread: records being overwritten
+// while they are read are skipped.
+template <std::size_t Capacity = 64>
+struct TraceBuffer
+{
+    static_assert(
+        Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+        "the capacity of a trace buffer must be a power of two");
+
+    static constexpr bool enabled = true;
+
+    template <std::size_t StateCount, std::size_t EventCount>
+    struct Instance
+    {
+        void on_transition(std::size_t from, std::size_t event, std::size_t to)
+        {
+            const auto sequence = head_.load(std::memory_order_relaxed) + 1;
+            auto& slot = slots_[(sequence - 1) & (Capacity - 1)];
+
+            // Readers see a sequence of 0 while the slot is being written.
+            slot.sequence.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.from.store(std::uint32_t(from), std::memory_order_relaxed);
+            slot.event.store(std::uint32_t(event), std::memory_order_relaxed);
+            slot.to.store(std::uint32_t(to), std::memory_order_relaxed);
+            slot.sequence.store(sequence, std::memory_order_release);
+            head_.store(sequence, std::memory_order_release);
+        }
+
+        void on_reject(std::size_t, std::size_t) {}
+
+        // Recorded transitions, oldest first.
+        std::vector<TraceRecord> trace() const
+        {
+            std::vector<TraceRecord> records;
+            const auto head = head_.load(std::memory_order_acquire);
+            const auto count = head < Capacity ? head : Capacity;
+
+            records.reserve(count);
+
+            for (auto sequence = head - count + 1; sequence <= head;
+                 ++sequence)
+            {
+                const auto& slot = slots_[(sequence - 1) & (Capacity - 1)];
+
+                if (slot.sequence.load(std::memory_order_acquire) != sequence)
+                {
+                    continue;
+                }
+
+                const TraceRecord record{
+                    sequence,
+                    slot.from.load(std::memory_order_relaxed),
+                    slot.event.load(std::memory_order_relaxed),
+                    slot.to.load(std::memory_order_relaxed)};
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+                {
+                    records.push_back(record);
+                }
+            }
+
+            return records;
+        }
+
+        // Writes the recorded transitions, oldest first, one per line.
+        void dump(std::ostream& stream) const
+        {
+            for (const auto& record : trace())
+            {
+                stream << record.sequence << ": " << record.from << " -> "
+                       << record.to << " on event " << record.event << "\n";
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            std::atomic<std::uint64_t> sequence{0};
+            std::atomic<std::uint32_t> from{0};
+            std::atomic<std::uint32_t> event{0};
+            std::atomic<std::uint32_t> to{0};
+        };
+
+        std::atomic<std::uint64_t> head_{0};
+        std::array<Slot, Capacity> slots_;
+    };
+};
+
+template <std::size_t Capacity>
+constexpr bool TraceBuffer<Capacity>::enabled;
+
+// Combination of several instrumentation policies, whose records are all
+// available from the instruments of the machine.
+template <typename... Policies>
+struct Instrumentation
+{
+    static constexpr bool enabled = true;
+
+    template <std::size_t StateCount, std::size_t EventCount>
+    struct Instance
+        : Policies::template Instance<StateCount, EventCount>...
+    {
+        void on_transition(std::size_t from, std::size_t event, std::size_t to)
+        {
+            const bool expanded[] = {
+                true,
+                (Policies::template Instance<StateCount, EventCount>::
+                     on_transition(from, event, to),
+                 true)...};
+            (void)expanded;
+        }
+
+        void on_reject(std::size_t state, std::size_t event)
+        {
+            const bool expanded[] = {
+                true,
+                (Policies::template Instance<StateCount, EventCount>::
+                     on_reject(state, event),
+                 true)...};
+            (void)expanded;
+        }
+    };
+};
+
+template <typename... Policies>
+constexpr bool Instrumentation<Policies...>::enabled;
+}; // namespace FSM
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef FSM_POOL_H
+#define FSM_POOL_H
+
+#include <fsm/fsm.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+namespace FSM {
+
+// Per-event tables used by FSMPool.
+// Unlike the tables of FSM, they cover every state of the machine so that a
+// pool never has to bounds check the states it stores.
+template <typename StateType, typename EventType, typename... Transitions>
+struct PoolTable
+{
+    using Narrow = NarrowState<StateType, Transitions...>;
+
+    static constexpr std::size_t size = StateCount<StateType, Transitions...>();
+
+    template <typename Value, std::size_t Size>
+    static constexpr std::array<Value, Size> table()
+    {
+        return detail::to_array(
+            detail::transition_table<
+                Value,
+                Size,
+                StateType,
+                EventType,
+                Transitions...>(),
+            std::make_index_sequence<Size>{});
+    }
+
+    // Table indexed and valued by the narrow state type, used by scalar code.
+    static constexpr std::array<Narrow, size> narrow = table<Narrow, size>();
+
+    // Same table widened to 32 bits, used by gather instructions.
+    static constexpr std::array<std::int32_t, size> wide =
+        table<std::int32_t, size>();
+
+    // Same table padded to 16 bytes, used by byte shuffle instructions when
+    // the machine has at most 16 states.
+    static constexpr std::array<std::uint8_t, 16> shuffle =
+        table<std::uint8_t, 16>();
+};
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr std::array<
+    typename PoolTable<StateType, EventType, Transitions...>::Narrow,
+    PoolTable<StateType, EventType, Transitions...>::size>
+    PoolTable<StateType, EventType, Transitions...>::narrow;
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr std::array<
+    std::int32_t,
+    PoolTable<StateType, EventType, Transitions...>::size>
+    PoolTable<StateType, EventType, Transitions...>::wide;
+
+template <typename StateType, typename EventType, typename... Transitions>
+constexpr std::array<std::uint8_t, 16>
+    PoolTable<StateType, EventType, Transitions...>::shuffle;
+
+namespace detail {
+struct ScalarKernel {};
+struct ShuffleKernel {};
+struct GatherKernel {};
+
+template <typename Table>
+constexpr bool shuffle_compatible()
+{
+    return Table::size <= 16 && sizeof(typename Table::Narrow) == 1;
+}
+
+#if defined(__AVX2__)
+template <typename Table>
+using PoolKernel = std::
+    conditional_t<shuffle_compatible<Table>(), ShuffleKernel, GatherKernel>;
+#elif defined(__SSSE3__)
+template <typename Table>
+using PoolKernel = std::
+    conditional_t<shuffle_compatible<Table>(), ShuffleKernel, ScalarKernel>;
+#else
+template <typename Table>
+using PoolKernel = ScalarKernel;
+#endif
+
+// Each kernel processes a prefix of the states and returns its length, the
+// remaining states being left to the scalar loop of FSMPool::process_all.
+template <typename Table, typename Narrow>
+std::size_t process_all(ScalarKernel, Narrow*, std::size_t)
+{
+    return 0;
+}
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+template <typename Table>
+std::size_t process_all(ShuffleKernel, std::uint8_t* states, std::size_t count)
+{
+    std::size_t index = 0;
+    const __m128i table = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(Table::shuffle.data()));
+
+#if defined(__AVX2__)
+    const __m256i table256 = _mm256_broadcastsi128_si256(table);
+
+    for (; index + 32 <= count; index += 32)
+    {
+        auto data = reinterpret_cast<__m256i*>(states + index);
+        _mm256_storeu_si256(
+            data, _mm256_shuffle_epi8(table256, _mm256_loadu_si256(data)));
+    }
+#endif
+
+    for (; index + 16 <= count; index += 16)
+    {
+        auto data = reinterpret_cast<__m128i*>(states + index);
+        _mm_storeu_si128(data, _mm_shuffle_epi8(table, _mm_loadu_si128(data)));
+    }
+
+    return index;
+}
+#endif
+
+#if defined(__AVX2__)
+inline __m256i load_indices(const std::uint8_t* states)
+{
+    return _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(states)));
+}
+
+inline __m256i load_indices(const std::uint16_t* states)
+{
+    return _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(states)));
+}
+
+inline __m256i load_indices(const std::uint32_t* states)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states));
+}
+
+inline __m128i pack_states(const __m256i states)
+{
+    return _mm_packus_epi32(
+        _mm256_castsi256_si128(states), _mm256_extracti128_si256(states, 1));
+}
+
+inline void store_states(std::uint8_t* destination, const __m256i states)
+{
+    const auto packed = pack_states(states);
+    _mm_storel_epi64(
+        reinterpret_cast<__m128i*>(destination),
+        _mm_packus_epi16(packed, packed));
+}
+
+inline void store_states(std::uint16_t* destination, const __m256i states)
+{
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(destination), pack_states(states));
+}
+
+inline void store_states(std::uint32_t* destination, const __m256i states)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), states);
+}
+
+template <typename Table, typename Narrow>
+std::size_t process_all(GatherKernel, Narrow* states, std::size_t count)
+{
+    const auto table = reinterpret_cast<const int*>(Table::wide.data());
+    std::size_t index = 0;
+
+    for (; index + 8 <= count; index += 8)
+    {
+        store_states(
+            states + index,
+            _mm256_i32gather_epi32(table, load_indices(states + index), 4));
+    }
+
+    return index;
+}
+#endif
+} // namespace detail
+
+// Structure-of-arrays storage for many instances of the same machine.
+// States are stored contiguously using the narrowest integer type able to hold
+// them, so that an event can be applied to every instance at once.
+// Transitions cannot have actions nor guards, events being applied to many
+// instances through their tables.
+template <typename StateType, typename... Transitions>
+struct FSMPool
+{
+    static_assert(
+        !AnyBehavior<Transitions...>::value,
+        "the transitions of a pool cannot have actions or guards");
+
+    using Narrow = NarrowState<StateType, Transitions...>;
+
+    // Throws std::out_of_range if the initial state appears in no
+    // transition, the tables of the pool only covering those states.
+    FSMPool(std::size_t size, StateType initial_state)
+        : states_(size, narrow_state(initial_state))
+    {
+    }
+
+    std::size_t size() const
+    {
+        return states_.size();
+    }
+
+    StateType state(std::size_t index) const
+    {
+        return StateType(states_[index]);
+    }
+
+    // Throws std::out_of_range if the state appears in no transition.
+    void set_state(std::size_t index, StateType state)
+    {
+        states_[index] = narrow_state(state);
+    }
+
+    const Narrow* data() const
+    {
+        return states_.data();
+    }
+
+    template <typename Event>
+    StateType process(std::size_t index, const Event&)
+    {
+        using Table = PoolTable<StateType, Event, Transitions...>;
+
+        states_[index] = Table::narrow[states_[index]];
+        return StateType(states_[index]);
+    }
+
+    // Apply an event to every instance of the pool.
+    template <typename Event>
+    void process_all(const Event&)
+    {
+        using Table = PoolTable<StateType, Event, Transitions...>;
+
+        auto states = states_.data();
+        const auto count = states_.size();
+        auto index = detail::process_all<Table>(
+            detail::PoolKernel<Table>{}, states, count);
+
+        for (; index < count; ++index)
+        {
+            states[index] = Table::narrow[states[index]];
+        }
+    }
+
+    // Apply an event to the instances designated by a range of indices.
+    // An index appearing several times receives the event several times.
+    template <typename Event, typename Iterator>
+    void process_indices(const Event&, Iterator first, Iterator last)
+    {
+        using Table = PoolTable<StateType, Event, Transitions...>;
+
+        auto states = states_.data();
+
+        for (; first != last; ++first)
+        {
+            auto& state = states[*first];
+            state = Table::narrow[state];
+        }
+    }
+
+private:
+    static Narrow narrow_state(StateType state)
+    {
+        const auto value = std::size_t(state);
+
+        if (value >= StateCount<StateType, Transitions...>())
+        {
+            throw std::out_of_range("state appears in no transition");
+        }
+
+        return Narrow(value);
+    }
+
+    std::vector<Narrow> states_;
+};
+}; // namespace FSM
+
+#endif
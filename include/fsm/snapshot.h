@@ -0,0 +1,739 @@
+#ifndef FSM_SNAPSHOT_H
+#define FSM_SNAPSHOT_H
+
+#include <fsm/pool.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace FSM {
+
+// Thrown when a snapshot file is not a valid snapshot of the expected machine.
+// Failures of the system calls reading or writing it are reported as
+// std::system_error.
+struct SnapshotError : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail {
+// Smallest number of bits able to hold count distinct values, at least 1.
+constexpr std::size_t bits_for(std::size_t count)
+{
+    std::size_t bits = 1;
+
+    while (bits < 63 && (std::uint64_t(1) << bits) < count)
+    {
+        ++bits;
+    }
+
+    return bits;
+}
+
+// FNV-1a hash of a value, fed to it byte by byte from the least significant
+// one, so that it does not depend on the platform.
+constexpr std::uint64_t fnv1a(std::uint64_t hash, std::uint64_t value)
+{
+    for (int byte = 0; byte < 8; ++byte)
+    {
+        hash ^= (value >> (8 * byte)) & 0xff;
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+// Hash of the numbers of states and events of a machine and of the origin
+// state, event index and destination state of each of its transitions.
+template <typename StateType, typename... Transitions>
+constexpr std::uint64_t machine_fingerprint()
+{
+    using Events = EventList<Transitions...>;
+
+    constexpr std::size_t from[] = {
+        0, std::size_t(Transitions::from_state)...};
+    constexpr std::size_t events[] = {
+        0, IndexOf<Events, typename Transitions::Event>::value...};
+    constexpr std::size_t to[] = {0, std::size_t(Transitions::to_state)...};
+
+    auto hash = fnv1a(
+        0xcbf29ce484222325, StateCount<StateType, Transitions...>());
+    hash = fnv1a(hash, Events::size);
+
+    for (std::size_t index = 1; index <= sizeof...(Transitions); ++index)
+    {
+        hash = fnv1a(hash, from[index]);
+        hash = fnv1a(hash, events[index]);
+        hash = fnv1a(hash, to[index]);
+    }
+
+    return hash;
+}
+
+enum SnapshotKind : std::uint16_t
+{
+    FullSnapshot,
+    DeltaSnapshot
+};
+
+// Header of a snapshot file, followed by 64-bit words: the states of every
+// instance packed with the minimum number of bits for a full snapshot, or one
+// record per changed instance, holding its index shifted left by that number
+// of bits and its state, for a delta snapshot.
+// A full snapshot has a base identifier drawn at random and a sequence number
+// of 0. The delta snapshots following it have its base identifier and
+// sequence numbers counting from 1, so that they are restored in order after
+// it.
+// Snapshots are written in the byte order of the machine writing them.
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint16_t version;
+    std::uint16_t kind;
+    std::uint32_t bits;
+    std::uint64_t fingerprint;
+    std::uint64_t instances;
+    std::uint64_t records;
+    std::uint64_t base;
+    std::uint64_t sequence;
+};
+
+static_assert(sizeof(SnapshotHeader) == 56, "words must stay aligned");
+
+constexpr char snapshot_magic[8] = {'F', 'S', 'M', 'S', 'N', 'A', 'P', '\0'};
+constexpr std::uint16_t snapshot_version = 2;
+
+// Base identifier of a new full snapshot.
+inline std::uint64_t new_snapshot_base()
+{
+    std::random_device device;
+    const auto time = std::chrono::system_clock::now().time_since_epoch();
+
+    return (std::uint64_t(device()) << 32 | device())
+        ^ std::uint64_t(time.count());
+}
+
+[[noreturn]] inline void throw_system_error(const std::string& message)
+{
+    throw std::system_error(errno, std::generic_category(), message);
+}
+
+// File descriptor closed when going out of scope.
+struct FileDescriptor
+{
+    explicit FileDescriptor(int descriptor) : descriptor(descriptor) {}
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    ~FileDescriptor()
+    {
+        if (descriptor >= 0) ::close(descriptor);
+    }
+
+    int descriptor;
+};
+
+inline void write_all(
+    int descriptor,
+    const void* data,
+    std::size_t size,
+    const std::string& path)
+{
+    auto bytes = static_cast<const char*>(data);
+
+    while (size > 0)
+    {
+        const auto written = ::write(descriptor, bytes, size);
+
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            throw_system_error("cannot write " + path);
+        }
+
+        bytes += written;
+        size -= std::size_t(written);
+    }
+}
+
+// Flushes a file to storage.
+inline void sync(int descriptor, const std::string& path)
+{
+    while (::fsync(descriptor) != 0)
+    {
+        if (errno != EINTR) throw_system_error("cannot write " + path);
+    }
+}
+
+// Flushes the entry of a file in its directory.
+inline void sync_directory(const std::string& path)
+{
+    const auto slash = path.rfind('/');
+    const auto directory = slash == std::string::npos
+        ? std::string(".")
+        : path.substr(0, slash == 0 ? 1 : slash);
+
+    FileDescriptor file(::open(directory.c_str(), O_RDONLY));
+
+    if (file.descriptor < 0)
+    {
+        throw_system_error("cannot open " + directory);
+    }
+
+    sync(file.descriptor, directory);
+}
+
+// Name of a temporary file next to path, unique among the threads and
+// processes writing snapshots.
+inline std::string temporary_path(const std::string& path)
+{
+    static std::atomic<unsigned long> counter{0};
+
+    return path + ".tmp." + std::to_string(::getpid()) + "."
+        + std::to_string(counter.fetch_add(1, std::memory_order_relaxed));
+}
+
+// Writes a snapshot to a temporary file, flushed to storage before being
+// renamed over path, so that neither a failure nor a crash leaves a truncated
+// snapshot behind.
+inline void write_snapshot(
+    const std::string& path,
+    const SnapshotHeader& header,
+    const std::vector<std::uint64_t>& words)
+{
+    const auto temporary = temporary_path(path);
+
+    try
+    {
+        FileDescriptor file(::open(
+            temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644));
+
+        if (file.descriptor < 0)
+        {
+            throw_system_error("cannot create " + temporary);
+        }
+
+        write_all(file.descriptor, &header, sizeof(header), temporary);
+        write_all(
+            file.descriptor,
+            words.data(),
+            words.size() * sizeof(std::uint64_t),
+            temporary);
+        sync(file.descriptor, temporary);
+
+        const auto descriptor = file.descriptor;
+        file.descriptor = -1;
+
+        if (::close(descriptor) != 0)
+        {
+            throw_system_error("cannot write " + temporary);
+        }
+
+        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            throw_system_error("cannot rename " + temporary + " to " + path);
+        }
+    }
+    catch (...)
+    {
+        std::remove(temporary.c_str());
+        throw;
+    }
+
+    sync_directory(path);
+}
+
+// Read-only memory mapping of a whole file.
+struct MappedFile
+{
+    explicit MappedFile(const std::string& path) : data(nullptr), size(0)
+    {
+        FileDescriptor file(::open(path.c_str(), O_RDONLY));
+
+        if (file.descriptor < 0)
+        {
+            throw_system_error("cannot open " + path);
+        }
+
+        struct stat status;
+
+        if (::fstat(file.descriptor, &status) != 0)
+        {
+            throw_system_error("cannot read " + path);
+        }
+
+        size = std::size_t(status.st_size);
+
+        if (size == 0) return;
+
+        data = ::mmap(
+            nullptr, size, PROT_READ, MAP_PRIVATE, file.descriptor, 0);
+
+        if (data == MAP_FAILED)
+        {
+            data = nullptr;
+            throw_system_error("cannot map " + path);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        if (data != nullptr) ::munmap(data, size);
+    }
+
+    void* data;
+    std::size_t size;
+};
+
+// Packs values of a given number of bits into words, the first value being
+// in the least significant bits of the first word.
+template <typename Value>
+std::vector<std::uint64_t> pack(
+    const Value* values,
+    std::size_t count,
+    std::size_t bits)
+{
+    std::vector<std::uint64_t> words((count * bits + 63) / 64);
+    std::uint64_t word = 0;
+    std::size_t filled = 0;
+    std::size_t index = 0;
+
+    for (std::size_t value = 0; value < count; ++value)
+    {
+        const auto bits_of_value = std::uint64_t(values[value]);
+
+        word |= bits_of_value << filled;
+        filled += bits;
+
+        if (filled >= 64)
+        {
+            words[index++] = word;
+            filled -= 64;
+            word = filled > 0 ? bits_of_value >> (bits - filled) : 0;
+        }
+    }
+
+    if (filled > 0) words[index] = word;
+
+    return words;
+}
+
+inline std::uint64_t unpack(
+    const std::uint64_t* words,
+    std::size_t index,
+    std::size_t bits)
+{
+    const auto bit = index * bits;
+    const auto offset = bit % 64;
+    auto value = words[bit / 64] >> offset;
+
+    if (offset + bits > 64)
+    {
+        value |= words[bit / 64 + 1] << (64 - offset);
+    }
+
+    return value & ((std::uint64_t(1) << bits) - 1);
+}
+} // namespace detail
+
+template <typename Pool>
+struct SnapshotFormat;
+
+// Number of bits of the packed states and fingerprint of the transitions of
+// the snapshots of a pool type.
+template <typename StateType, typename... Transitions>
+struct SnapshotFormat<FSMPool<StateType, Transitions...>>
+{
+    using State = StateType;
+
+    static constexpr std::size_t state_count =
+        StateCount<StateType, Transitions...>();
+    static constexpr std::size_t bits = detail::bits_for(state_count);
+    static constexpr std::uint64_t fingerprint =
+        detail::machine_fingerprint<StateType, Transitions...>();
+
+    static detail::SnapshotHeader header(
+        detail::SnapshotKind kind,
+        std::size_t instances,
+        std::size_t records,
+        std::uint64_t base,
+        std::uint64_t sequence)
+    {
+        detail::SnapshotHeader header{};
+        std::memcpy(
+            header.magic, detail::snapshot_magic, sizeof(header.magic));
+        header.version = detail::snapshot_version;
+        header.kind = kind;
+        header.bits = std::uint32_t(bits);
+        header.fingerprint = fingerprint;
+        header.instances = instances;
+        header.records = records;
+        header.base = base;
+        header.sequence = sequence;
+        return header;
+    }
+};
+
+template <typename StateType, typename... Transitions>
+constexpr std::size_t
+    SnapshotFormat<FSMPool<StateType, Transitions...>>::state_count;
+
+template <typename StateType, typename... Transitions>
+constexpr std::size_t SnapshotFormat<FSMPool<StateType, Transitions...>>::bits;
+
+template <typename StateType, typename... Transitions>
+constexpr std::uint64_t
+    SnapshotFormat<FSMPool<StateType, Transitions...>>::fingerprint;
+
+// Writes the states of every instance of a pool.
+// Returns the base identifier of the snapshot.
+template <typename Pool>
+std::uint64_t save_snapshot(const Pool& pool, const std::string& path)
+{
+    using Format = SnapshotFormat<Pool>;
+
+    const auto base = detail::new_snapshot_base();
+
+    detail::write_snapshot(
+        path,
+        Format::header(detail::FullSnapshot, pool.size(), 0, base, 0),
+        detail::pack(pool.data(), pool.size(), Format::bits));
+
+    return base;
+}
+
+// Last snapshot restored into a pool, checked when restoring a delta snapshot
+// so that delta snapshots are only applied in order after their full
+// snapshot.
+struct SnapshotPosition
+{
+    std::uint64_t base = 0;
+    std::uint64_t sequence = 0;
+    bool restored = false;
+};
+
+// Snapshot mapped in memory.
+// Opening it only checks its header, states being read from the mapping when
+// accessed or restored.
+template <typename Pool>
+struct SnapshotView
+{
+    using Format = SnapshotFormat<Pool>;
+    using State = typename Format::State;
+
+    explicit SnapshotView(const std::string& path) : file_(path)
+    {
+        if (file_.size < sizeof(detail::SnapshotHeader))
+        {
+            throw SnapshotError(path + " is too short to be a snapshot");
+        }
+
+        const auto& header = this->header();
+
+        if (std::memcmp(
+                header.magic, detail::snapshot_magic, sizeof(header.magic))
+                != 0
+            || header.version != detail::snapshot_version
+            || header.kind > detail::DeltaSnapshot)
+        {
+            throw SnapshotError(path + " is not a snapshot");
+        }
+
+        if (header.fingerprint != Format::fingerprint
+            || header.bits != Format::bits)
+        {
+            throw SnapshotError(path + " is a snapshot of another machine");
+        }
+
+        // Counts read from the file are bounded by its size before being
+        // used to compute its expected size, so that they cannot overflow.
+        const auto payload = file_.size - sizeof(header);
+        const auto capacity = payload / sizeof(std::uint64_t);
+
+        if ((is_delta() ? header.records > capacity
+                        : header.instances > capacity * 64 / Format::bits)
+            || payload != words() * sizeof(std::uint64_t))
+        {
+            throw SnapshotError(path + " is truncated");
+        }
+
+        if (is_delta() ? header.sequence == 0 : header.sequence != 0)
+        {
+            throw SnapshotError(path + " has an invalid sequence number");
+        }
+    }
+
+    // Number of instances of the pool the snapshot was taken from.
+    std::size_t size() const
+    {
+        return std::size_t(header().instances);
+    }
+
+    // Whether the snapshot only holds the instances changed since a previous
+    // one, see DeltaCheckpoint.
+    bool is_delta() const
+    {
+        return header().kind == detail::DeltaSnapshot;
+    }
+
+    // Base identifier of the full snapshot, or of the full snapshot a delta
+    // snapshot follows.
+    std::uint64_t base() const
+    {
+        return header().base;
+    }
+
+    // 0 for a full snapshot, position after it for a delta snapshot.
+    std::uint64_t sequence() const
+    {
+        return header().sequence;
+    }
+
+    // State of an instance in a full snapshot.
+    // Throws SnapshotError for a delta snapshot, which does not hold every
+    // instance, and std::out_of_range for an index beyond the snapshot.
+    State state(std::size_t index) const
+    {
+        if (is_delta())
+        {
+            throw SnapshotError("delta snapshots hold no state by instance");
+        }
+
+        if (index >= size())
+        {
+            throw std::out_of_range("instance beyond the snapshot");
+        }
+
+        return State(detail::unpack(data(), index, Format::bits));
+    }
+
+    // Sets the states of a pool of the same size to those of a full
+    // snapshot.
+    // Throws SnapshotError for a delta snapshot, which needs the position of
+    // the pool.
+    void restore(Pool& pool) const
+    {
+        if (is_delta())
+        {
+            throw SnapshotError(
+                "delta snapshots need the position of the pool to restore");
+        }
+
+        SnapshotPosition position;
+        restore(pool, position);
+    }
+
+    // Sets the states of a pool of the same size to those of a full
+    // snapshot, or applies the changes of the delta snapshot following the
+    // position of the pool, and advances the position.
+    void restore(Pool& pool, SnapshotPosition& position) const
+    {
+        if (pool.size() != size())
+        {
+            throw SnapshotError("snapshot and pool sizes differ");
+        }
+
+        if (is_delta())
+        {
+            if (!position.restored || position.base != base())
+            {
+                throw SnapshotError(
+                    "delta snapshot follows another full snapshot");
+            }
+
+            if (sequence() != position.sequence + 1)
+            {
+                throw SnapshotError("delta snapshot is out of order");
+            }
+
+            restore_delta(pool);
+        }
+        else
+        {
+            restore_full(pool);
+        }
+
+        position.base = base();
+        position.sequence = sequence();
+        position.restored = true;
+    }
+
+private:
+    const detail::SnapshotHeader& header() const
+    {
+        return *static_cast<const detail::SnapshotHeader*>(file_.data);
+    }
+
+    const std::uint64_t* data() const
+    {
+        return reinterpret_cast<const std::uint64_t*>(&header() + 1);
+    }
+
+    std::size_t words() const
+    {
+        const auto& header = this->header();
+        return is_delta() ? std::size_t(header.records)
+                          : (size() * Format::bits + 63) / 64;
+    }
+
+    static void check_state(std::uint64_t state)
+    {
+        if (state >= Format::state_count)
+        {
+            throw SnapshotError("snapshot holds an invalid state");
+        }
+    }
+
+    // Every state is checked before the first one is set, so that an
+    // invalid snapshot leaves the pool unchanged.
+    void restore_full(Pool& pool) const
+    {
+        const auto words = data();
+        const auto count = size();
+
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            check_state(detail::unpack(words, index, Format::bits));
+        }
+
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            pool.set_state(
+                index, State(detail::unpack(words, index, Format::bits)));
+        }
+    }
+
+    void restore_delta(Pool& pool) const
+    {
+        const auto records = data();
+        const auto count = std::size_t(header().records);
+        const auto mask = (std::uint64_t(1) << Format::bits) - 1;
+
+        for (std::size_t record = 0; record < count; ++record)
+        {
+            if (records[record] >> Format::bits >= size())
+            {
+                throw SnapshotError("snapshot holds an invalid instance");
+            }
+
+            check_state(records[record] & mask);
+        }
+
+        for (std::size_t record = 0; record < count; ++record)
+        {
+            pool.set_state(
+                std::size_t(records[record] >> Format::bits),
+                State(records[record] & mask));
+        }
+    }
+
+    detail::MappedFile file_;
+};
+
+// Restores a full snapshot.
+template <typename Pool>
+void restore_snapshot(Pool& pool, const std::string& path)
+{
+    SnapshotView<Pool>(path).restore(pool);
+}
+
+// Restores a full snapshot or the delta snapshot following position.
+template <typename Pool>
+void restore_snapshot(
+    Pool& pool,
+    const std::string& path,
+    SnapshotPosition& position)
+{
+    SnapshotView<Pool>(path).restore(pool, position);
+}
+
+// Writes a full snapshot of a pool, then delta snapshots holding only the
+// instances whose state changed since the previous checkpoint.
+// A pool is recovered by restoring the full snapshot, then every delta
+// snapshot in order, with the same SnapshotPosition.
+template <typename Pool>
+struct DeltaCheckpoint
+{
+    using Format = SnapshotFormat<Pool>;
+
+    DeltaCheckpoint(const Pool& pool, const std::string& path)
+        : baseline_(pool.data(), pool.data() + pool.size()),
+          base_(save_snapshot(pool, path)),
+          sequence_(0)
+    {
+    }
+
+    // Returns the number of instances written.
+    // Throws SnapshotError if the pool is not the size of the one the
+    // checkpoint was created with, or too large for its indices to fit in
+    // records.
+    std::size_t save(const Pool& pool, const std::string& path)
+    {
+        if (pool.size() != baseline_.size())
+        {
+            throw SnapshotError("checkpoint and pool sizes differ");
+        }
+
+        if (std::uint64_t(baseline_.size()) >> (64 - Format::bits) != 0)
+        {
+            throw SnapshotError("pool too large for delta snapshots");
+        }
+
+        const auto states = pool.data();
+        std::vector<std::uint64_t> records;
+
+        for (std::size_t index = 0; index < baseline_.size(); ++index)
+        {
+            if (states[index] != baseline_[index])
+            {
+                records.push_back(
+                    std::uint64_t(index) << Format::bits | states[index]);
+            }
+        }
+
+        detail::write_snapshot(
+            path,
+            Format::header(
+                detail::DeltaSnapshot,
+                baseline_.size(),
+                records.size(),
+                base_,
+                sequence_ + 1),
+            records);
+        ++sequence_;
+
+        for (const auto record : records)
+        {
+            baseline_[record >> Format::bits] = states[record >> Format::bits];
+        }
+
+        return records.size();
+    }
+
+private:
+    std::vector<typename Pool::Narrow> baseline_;
+    const std::uint64_t base_;
+    std::uint64_t sequence_;
+};
+}; // namespace FSM
+
+#endif
@@ -0,0 +1,301 @@
+#include <catch/catch.hpp>
+#include <fsm/composed.h>
+#include <random>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+struct Toggle {};
+struct Unknown {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+enum Ring
+{
+    First,
+    Second,
+    Third
+};
+
+enum Switch
+{
+    Off,
+    On
+};
+
+using Lifecycle = FSM::FSM<
+    State,
+    FSM::Transition<State, NotInitialized, Event0, Initialized>,
+    FSM::Transition<State, Initialized, Event0, Started>,
+    FSM::Transition<State, Started, Event1, Stopped>,
+    FSM::Transition<State, Stopped, Event0, NotInitialized>>;
+
+using Rotation = FSM::FSM<
+    Ring,
+    FSM::Transition<Ring, First, Event0, Second>,
+    FSM::Transition<Ring, Second, Event0, Third>,
+    FSM::Transition<Ring, Third, Event0, First>>;
+
+using Light = FSM::FSM<
+    Switch,
+    FSM::Transition<Switch, Off, Toggle, On>,
+    FSM::Transition<Switch, On, Toggle, Off>,
+    FSM::Transition<Switch, On, Event1, Off>>;
+
+using Lockstep = FSM::FSM<
+    Switch,
+    FSM::Transition<Switch, Off, Event0, On>,
+    FSM::Transition<Switch, On, Event0, Off>>;
+
+struct Event2 {};
+struct Event3 {};
+struct Event4 {};
+struct Event5 {};
+
+enum Quarter
+{
+    Q0,
+    Q1,
+    Q2,
+    Q3
+};
+
+// Ring of four states moving forward on Advance, back to the first state
+// from the last one on Back and from the second one on Toggle.
+template <typename Advance, typename Back>
+using Dial = FSM::FSM<
+    Quarter,
+    FSM::Transition<Quarter, Q0, Advance, Q1>,
+    FSM::Transition<Quarter, Q1, Advance, Q2>,
+    FSM::Transition<Quarter, Q2, Advance, Q3>,
+    FSM::Transition<Quarter, Q3, Advance, Q0>,
+    FSM::Transition<Quarter, Q3, Back, Q0>,
+    FSM::Transition<Quarter, Q1, Toggle, Q0>>;
+
+enum Fifth
+{
+    F0,
+    F1,
+    F2,
+    F3,
+    F4
+};
+
+// Ring of five states moving forward on Advance.
+template <typename Advance>
+using Pentagon = FSM::FSM<
+    Fifth,
+    FSM::Transition<Fifth, F0, Advance, F1>,
+    FSM::Transition<Fifth, F1, Advance, F2>,
+    FSM::Transition<Fifth, F2, Advance, F3>,
+    FSM::Transition<Fifth, F3, Advance, F4>,
+    FSM::Transition<Fifth, F4, Advance, F0>>;
+
+using Dials = std::tuple<
+    Dial<Event0, Event1>,
+    Dial<Event1, Event2>,
+    Dial<Event2, Event3>,
+    Dial<Event3, Event4>,
+    Dial<Event4, Event5>,
+    Dial<Event5, Event0>>;
+
+template <typename Composed, std::size_t... Indices>
+void check_dials(
+    const Composed& composed,
+    const Dials& dials,
+    std::index_sequence<Indices...>)
+{
+    const bool expanded[] = {
+        true,
+        (composed.template state<Indices>() == std::get<Indices>(dials).state_)
+            ...};
+
+    for (const bool matches : expanded)
+    {
+        REQUIRE(matches);
+    }
+}
+
+template <typename Event, std::size_t... Indices>
+void process_dials(Dials& dials, std::index_sequence<Indices...>)
+{
+    const bool expanded[] = {
+        true, (std::get<Indices>(dials).process(Event()), true)...};
+    (void)expanded;
+}
+
+} // namespace
+
+TEST_CASE("Composed machines match their regions")
+{
+    using Composed =
+        FSM::ComposedFSM<Lifecycle, FSM::Start<Rotation, Third>, Light>;
+
+    static_assert(Composed::region_count == 3, "");
+    static_assert(Composed::event_count == 3, "");
+    static_assert(Composed::event_index<Toggle>() == 2, "");
+
+    Composed composed;
+    Lifecycle lifecycle(NotInitialized);
+    Rotation rotation(Third);
+    Light light(Off);
+    std::mt19937 random(42);
+
+    REQUIRE(composed.state<0>() == NotInitialized);
+    REQUIRE(composed.state<1>() == Third);
+    REQUIRE(composed.state<2>() == Off);
+
+    for (int round = 0; round < 1000; ++round)
+    {
+        switch (random() % 5)
+        {
+            case 0:
+                composed.process(Event0());
+                lifecycle.process(Event0());
+                rotation.process(Event0());
+                break;
+            case 1:
+                composed.process(Event1());
+                lifecycle.process(Event1());
+                light.process(Event1());
+                break;
+            case 2:
+                composed.process(Toggle());
+                light.process(Toggle());
+                break;
+            case 3:
+                composed.process(Unknown());
+                break;
+            default:
+                composed.process_id(Composed::event_index<Event0>());
+                lifecycle.process(Event0());
+                rotation.process(Event0());
+                break;
+        }
+
+        REQUIRE(composed.state<0>() == lifecycle.state_);
+        REQUIRE(composed.state<1>() == rotation.state_);
+        REQUIRE(composed.state<2>() == light.state_);
+    }
+}
+
+TEST_CASE("Unreachable combinations of states are pruned")
+{
+    // Both regions only move on Event0, so that their states stay in step.
+    using Stepped = FSM::ComposedFSM<Rotation, FSM::Start<Rotation, Second>>;
+    using Alternating = FSM::ComposedFSM<Rotation, Lockstep>;
+    using Independent = FSM::ComposedFSM<Rotation, Light>;
+
+    static_assert(Stepped::state_count == 3, "");
+    static_assert(Alternating::state_count == 6, "");
+    static_assert(Independent::state_count == 6, "");
+    static_assert(sizeof(Stepped::Table::transitions) == 3, "");
+
+    Stepped stepped;
+
+    for (int round = 0; round < 10; ++round)
+    {
+        REQUIRE(stepped.state<1>() == Ring((stepped.state<0>() + 1) % 3));
+        stepped.process(Event0());
+    }
+}
+
+TEST_CASE("Six regions of four states are composed")
+{
+    using Composed = FSM::ComposedFSM<
+        Dial<Event0, Event1>,
+        Dial<Event1, Event2>,
+        Dial<Event2, Event3>,
+        Dial<Event3, Event4>,
+        Dial<Event4, Event5>,
+        Dial<Event5, Event0>>;
+    using Indices = std::make_index_sequence<6>;
+
+    static_assert(Composed::event_count == 7, "");
+    // Every combination but the one with all dials in Q3, the event advancing
+    // a dial to Q3 sending the previous dial back to Q0.
+    static_assert(Composed::state_count == 4095, "");
+
+    Composed composed;
+    Dials dials(Q0, Q0, Q0, Q0, Q0, Q0);
+    std::mt19937 random(42);
+
+    for (int round = 0; round < 1000; ++round)
+    {
+        switch (random() % 7)
+        {
+            case 0:
+                composed.process(Event0());
+                process_dials<Event0>(dials, Indices{});
+                break;
+            case 1:
+                composed.process(Event1());
+                process_dials<Event1>(dials, Indices{});
+                break;
+            case 2:
+                composed.process(Event2());
+                process_dials<Event2>(dials, Indices{});
+                break;
+            case 3:
+                composed.process(Event3());
+                process_dials<Event3>(dials, Indices{});
+                break;
+            case 4:
+                composed.process(Event4());
+                process_dials<Event4>(dials, Indices{});
+                break;
+            case 5:
+                composed.process(Event5());
+                process_dials<Event5>(dials, Indices{});
+                break;
+            default:
+                composed.process(Toggle());
+                process_dials<Toggle>(dials, Indices{});
+                break;
+        }
+
+        check_dials(composed, dials, Indices{});
+    }
+}
+
+TEST_CASE("Six regions of five states are composed")
+{
+    using Composed = FSM::ComposedFSM<
+        Pentagon<Event0>,
+        Pentagon<Event1>,
+        Pentagon<Event2>,
+        Pentagon<Event3>,
+        Pentagon<Event4>,
+        Pentagon<Event5>>;
+
+    // Every combination is reachable, close to the limit of the search.
+    static_assert(Composed::state_count == 15625, "");
+    static_assert(Composed::Table::state_limit < 20000, "");
+
+    Composed composed;
+
+    composed.process(Event0());
+    composed.process(Event2());
+    composed.process(Event2());
+    composed.process(Event5());
+
+    for (int round = 0; round < 5; ++round)
+    {
+        composed.process(Event4());
+    }
+
+    REQUIRE(composed.state<0>() == F1);
+    REQUIRE(composed.state<1>() == F0);
+    REQUIRE(composed.state<2>() == F2);
+    REQUIRE(composed.state<4>() == F0);
+    REQUIRE(composed.state<5>() == F1);
+}
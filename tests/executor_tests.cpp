@@ -0,0 +1,180 @@
+#include <catch/catch.hpp>
+#include <fsm/executor.h>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Next {};
+struct Reset {};
+struct Block {};
+
+enum Counter
+{
+    Zero,
+    One,
+    Two,
+    Three,
+    Four
+};
+
+// Machine whose state depends on the order of its events.
+using Machine = FSM::FSM<
+    Counter,
+    FSM::Transition<Counter, Zero, Next, One>,
+    FSM::Transition<Counter, One, Next, Two>,
+    FSM::Transition<Counter, Two, Next, Three>,
+    FSM::Transition<Counter, Three, Next, Four>,
+    FSM::Transition<Counter, Four, Next, Zero>,
+    FSM::Transition<Counter, One, Reset, Zero>,
+    FSM::Transition<Counter, Three, Reset, Zero>>;
+
+std::atomic<bool> entered{false};
+std::atomic<bool> released{false};
+
+// Instrumentation keeping the worker busy on its first transition until the
+// test releases it.
+struct Wait
+{
+    static constexpr bool enabled = true;
+
+    template <std::size_t StateCount, std::size_t EventCount>
+    struct Instance
+    {
+        void on_transition(std::size_t from, std::size_t, std::size_t)
+        {
+            if (from != Zero) return;
+
+            entered = true;
+
+            while (!released)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void on_reject(std::size_t, std::size_t) {}
+    };
+};
+
+using Blocking = FSM::BasicFSM<
+    Counter,
+    Wait,
+    FSM::Transition<Counter, Zero, Block, One>,
+    FSM::Transition<Counter, One, Next, Two>,
+    FSM::Transition<Counter, Two, Next, Three>>;
+
+} // namespace
+
+TEST_CASE("FSMExecutor keeps the order of the events of every instance")
+{
+    const std::size_t size = 1000;
+    const std::size_t producers = 4;
+
+    FSM::ExecutorOptions options;
+    options.shards = 7;
+    options.threads = 3;
+    options.queue_capacity = 8;
+    options.batch_size = 5;
+
+    FSM::FSMExecutor<Machine> executor(size, Machine(Zero), options);
+    std::vector<Machine> expected(size, Machine(Zero));
+    std::vector<std::thread> threads;
+
+    for (std::size_t producer = 0; producer < producers; ++producer)
+    {
+        threads.emplace_back([&executor, &expected, producer] {
+            std::mt19937 random(42 + producer);
+
+            for (int round = 0; round < 20000; ++round)
+            {
+                // Every producer feeds its own instances.
+                const auto instance =
+                    random() % (size / producers) * producers + producer;
+
+                if (random() % 3 == 0)
+                {
+                    executor.submit(instance, Reset());
+                    expected[instance].process(Reset());
+                }
+                else
+                {
+                    executor.submit(instance, Next());
+                    expected[instance].process(Next());
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    executor.drain();
+
+    REQUIRE(executor.dropped() == 0);
+
+    for (std::size_t instance = 0; instance < size; ++instance)
+    {
+        REQUIRE(
+            executor.instance(instance).state_ == expected[instance].state_);
+    }
+}
+
+TEST_CASE("FSMExecutor drops events when its queues are full")
+{
+    FSM::ExecutorOptions options;
+    options.shards = 1;
+    options.threads = 1;
+    options.queue_capacity = 2;
+    options.backpressure = FSM::Backpressure::Drop;
+
+    FSM::FSMExecutor<Blocking> executor(1, Blocking(Zero), options);
+
+    REQUIRE(executor.submit(0, Block()));
+
+    while (!entered)
+    {
+        std::this_thread::yield();
+    }
+
+    REQUIRE(executor.submit(0, Next()));
+    REQUIRE(executor.submit(0, Next()));
+    REQUIRE_FALSE(executor.submit(0, Next()));
+    REQUIRE(executor.dropped() == 1);
+
+    released = true;
+    executor.drain();
+
+    REQUIRE(executor.instance(0).state_ == Three);
+}
+
+TEST_CASE("FSMExecutor rejects invalid options and instances")
+{
+    FSM::ExecutorOptions options;
+    options.shards = 0;
+
+    REQUIRE_THROWS_AS(
+        FSM::FSMExecutor<Machine>(4, Machine(Zero), options),
+        std::invalid_argument);
+
+    options.shards = 3;
+    options.threads = 1;
+
+    FSM::FSMExecutor<Machine> executor(4, Machine(Zero), options);
+
+    REQUIRE_THROWS_AS(executor.submit(4, Next()), std::out_of_range);
+    REQUIRE_THROWS_AS(
+        executor.submit_id(0, std::size_t(UINT32_MAX) + 1),
+        std::out_of_range);
+    REQUIRE(executor.submit(3, Next()));
+    executor.drain();
+
+    REQUIRE(executor.instance(3).state_ == One);
+    REQUIRE(executor.instance(0).state_ == Zero);
+}
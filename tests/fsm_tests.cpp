@@ -1,6 +1,8 @@
+#include "ring_machine.h"
 #include <catch/catch.hpp>
 #include <fsm/fsm.h>
 #include <iostream>
+#include <sstream>
 
 struct Event0 {};
 struct Event1 {};
@@ -35,3 +37,274 @@ TEST_CASE("FSM")
     REQUIRE(fsm.process(Event0()) == Stopped);
     REQUIRE(fsm.process(Event1()) == Stopped);
 }
+
+TEST_CASE("Transition tables are built at compile time")
+{
+    using FSM::transitions;
+
+    constexpr const auto& event0_transitions = transitions<
+        State,
+        Event0,
+        Transition<NotInitialized, Event0, Initialized>,
+        Transition<Initialized, Event0, Started>,
+        Transition<Started, Event1, Stopped>>;
+
+    static_assert(event0_transitions.size() == 2, "");
+    static_assert(event0_transitions[NotInitialized] == Initialized, "");
+    static_assert(event0_transitions[Initialized] == Started, "");
+
+    constexpr const auto& event1_transitions = transitions<
+        State,
+        Event1,
+        Transition<Started, Event1, Stopped>,
+        Transition<NotInitialized, Event0, Initialized>>;
+
+    static_assert(event1_transitions.size() == 3, "");
+    static_assert(event1_transitions[NotInitialized] == NotInitialized, "");
+    static_assert(event1_transitions[Started] == Stopped, "");
+
+    REQUIRE(event0_transitions[NotInitialized] == Initialized);
+}
+
+TEST_CASE("Events can be processed by index")
+{
+    using FSM::FSM;
+
+    using Machine = FSM<
+        State,
+        Transition<NotInitialized, Event0, Initialized>,
+        Transition<Initialized, Event0, Started>,
+        Transition<Started, Event1, Stopped>>;
+
+    static_assert(Machine::event_count == 2, "");
+    static_assert(Machine::event_index<Event0>() == 0, "");
+    static_assert(Machine::event_index<Event1>() == 1, "");
+    static_assert(Machine::event_index<int>() == 2, "");
+
+    Machine fsm(NotInitialized);
+
+    REQUIRE(fsm.process_id(1) == NotInitialized);
+    REQUIRE(fsm.process_id(0) == Initialized);
+    REQUIRE(fsm.process_id(2) == Initialized);
+    REQUIRE(fsm.process_id(0) == Started);
+    REQUIRE(fsm.process_id(1) == Stopped);
+    REQUIRE(fsm.process_id(0) == Stopped);
+
+#if __cplusplus >= 201703L
+    using Variant = Machine::events_as<std::variant>;
+
+    Machine other(NotInitialized);
+
+    REQUIRE(other.process(Variant(Event1())) == NotInitialized);
+    REQUIRE(other.process(Variant(Event0())) == Initialized);
+    REQUIRE(other.process(Variant(Event0())) == Started);
+    REQUIRE(other.process(Variant(Event1())) == Stopped);
+
+    Machine reordered(Started);
+
+    REQUIRE(reordered.process(std::variant<int, Event1>(0)) == Started);
+    REQUIRE(reordered.process(std::variant<int, Event1>(Event1())) == Stopped);
+#endif
+}
+
+namespace {
+
+struct Counter
+{
+    static int count;
+
+    static void increment(const Event0&)
+    {
+        ++count;
+    }
+};
+
+int Counter::count = 0;
+
+struct Amount
+{
+    int value;
+};
+
+int total = 0;
+
+struct AddAmount
+{
+    void operator()(const Amount& amount) const
+    {
+        total += amount.value;
+    }
+};
+
+struct IsPositive
+{
+    bool operator()(const Amount& amount) const
+    {
+        return amount.value > 0;
+    }
+};
+
+struct IsZero
+{
+    bool operator()(const Amount& amount) const
+    {
+        return amount.value == 0;
+    }
+};
+
+} // namespace
+
+TEST_CASE("Transitions invoke their actions and guards")
+{
+    using FSM::FSM;
+
+    using Machine = FSM<
+        State,
+        Transition<NotInitialized, Event0, Initialized>,
+        FSM::Transition<
+            State,
+            Initialized,
+            Event0,
+            Started,
+            FSM::Call<void (*)(const Event0&), &Counter::increment>>,
+        FSM::Transition<
+            State,
+            Started,
+            Amount,
+            Stopped,
+            AddAmount,
+            IsPositive>,
+        FSM::Transition<
+            State,
+            Started,
+            Amount,
+            NotInitialized,
+            FSM::NoAction,
+            IsZero>,
+        Transition<Stopped, Event1, Started>>;
+
+    Counter::count = 0;
+    total = 0;
+
+    Machine fsm(NotInitialized);
+
+    REQUIRE(fsm.process(Event0()) == Initialized);
+    REQUIRE(Counter::count == 0);
+    REQUIRE(fsm.process(Event0()) == Started);
+    REQUIRE(Counter::count == 1);
+    REQUIRE(fsm.process(Event0()) == Started);
+    REQUIRE(Counter::count == 1);
+
+    REQUIRE(fsm.process(Amount{-3}) == Started);
+    REQUIRE(total == 0);
+    REQUIRE(fsm.process(Amount{5}) == Stopped);
+    REQUIRE(total == 5);
+    REQUIRE(fsm.process(Amount{7}) == Stopped);
+    REQUIRE(total == 5);
+
+    REQUIRE(fsm.process(Event1()) == Started);
+    REQUIRE(fsm.process(Amount{0}) == NotInitialized);
+    REQUIRE(total == 5);
+
+#if __cplusplus >= 201703L
+    Machine other(Started);
+
+    Machine::events_as<std::variant> amount = Amount{2};
+
+    REQUIRE(other.process(amount) == Stopped);
+    REQUIRE(total == 7);
+#endif
+}
+
+namespace {
+
+using Tests::Next;
+using Tests::Ring;
+
+struct Jump {};
+struct Skip {};
+
+constexpr std::size_t ring_size = 300;
+
+template <typename StateType, typename... Transitions>
+struct RingTypes
+{
+    using Machine = FSM::FSM<Ring, Transitions...>;
+
+    template <typename Event>
+    using Table = FSM::CompressedTable<Ring, Event, Transitions...>;
+    template <typename Event>
+    using Dense = FSM::DenseTable<Ring, Event, Transitions...>;
+    template <typename Event>
+    using Sparse = FSM::SparseTable<Ring, Event, Transitions...>;
+    template <typename Event>
+    using Bitmap = FSM::BitmapTable<Ring, Event, Transitions...>;
+    template <typename Event>
+    using Reference = FSM::TransitionTable<Ring, Event, Transitions...>;
+};
+
+// Next is defined for every state, Skip for every fourth state and Jump for a
+// handful of states.
+using RingTypesOf = Tests::RingMachine<
+    ring_size,
+    RingTypes,
+    typename Tests::RingTransitions<Skip, ring_size, 4, 2>::type,
+    FSM::TypeList<
+        FSM::Transition<Ring, Ring(250), Jump, Ring(0)>,
+        FSM::Transition<Ring, Ring(260), Jump, Ring(10)>,
+        FSM::Transition<Ring, Ring(270), Jump, Ring(20)>,
+        FSM::Transition<Ring, Ring(280), Jump, Ring(30)>,
+        FSM::Transition<Ring, Ring(290), Jump, Ring(40)>,
+        FSM::Transition<Ring, Ring(295), Jump, Ring(50)>>>;
+
+template <typename Event>
+void check_ring_table()
+{
+    using Reference = RingTypesOf::Reference<Event>;
+
+    for (std::size_t state = 0; state < ring_size + 10; ++state)
+    {
+        RingTypesOf::Machine fsm{Ring(state)};
+        const auto expected =
+            state < Reference::size ? Reference::value[state] : Ring(state);
+
+        REQUIRE(fsm.process(Event()) == expected);
+    }
+}
+
+} // namespace
+
+TEST_CASE("Transition table layouts depend on their density")
+{
+    using Types = RingTypesOf;
+
+    static_assert(
+        std::is_same<Types::Table<Next>, Types::Dense<Next>>::value, "");
+    static_assert(
+        std::is_same<Types::Table<Jump>, Types::Sparse<Jump>>::value, "");
+    static_assert(
+        std::is_same<Types::Table<Skip>, Types::Bitmap<Skip>>::value, "");
+
+    static_assert(Types::Dense<Next>::bytes == 600, "");
+    static_assert(Types::Sparse<Jump>::bytes == 24, "");
+    static_assert(Types::Bitmap<Skip>::bytes == 5 * (8 + 1) + 75 * 2, "");
+    static_assert(
+        Types::Machine::table_bytes()
+            == 600 + 24 + 5 * (8 + 1) + 75 * 2 + 300 * 3 * 2,
+        "");
+
+    check_ring_table<Next>();
+    check_ring_table<Skip>();
+    check_ring_table<Jump>();
+
+    std::ostringstream report;
+    Types::Machine::report(report);
+
+    REQUIRE(
+        report.str()
+        == "event 0: dense table, 600 bytes\n"
+           "event 1: bitmap table, 195 bytes\n"
+           "event 2: sparse table, 24 bytes\n"
+           "index table: 1800 bytes\n"
+           "total: 2619 bytes\n");
+}
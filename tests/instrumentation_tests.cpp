@@ -0,0 +1,236 @@
+#include <catch/catch.hpp>
+#include <fsm/instrumentation.h>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+struct Unknown {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+template <State FromState, typename EventType, State ToState>
+using Transition = FSM::Transition<State, FromState, EventType, ToState>;
+
+template <typename Policy>
+using Machine = FSM::BasicFSM<
+    State,
+    Policy,
+    Transition<NotInitialized, Event0, Initialized>,
+    Transition<Initialized, Event0, Started>,
+    Transition<Started, Event1, Stopped>,
+    Transition<Stopped, Event1, Stopped>>;
+
+bool allow = false;
+
+struct IsAllowed
+{
+    template <typename Event>
+    bool operator()(const Event&) const
+    {
+        return allow;
+    }
+};
+
+// Clock advanced by hand.
+std::uint64_t ticks = 0;
+
+struct ManualClock
+{
+    static std::uint64_t now()
+    {
+        return ticks;
+    }
+};
+
+} // namespace
+
+TEST_CASE("Machines are not instrumented by default")
+{
+    static_assert(
+        sizeof(Machine<FSM::NoInstrumentation>) == sizeof(State),
+        "uninstrumented machines should only hold their state");
+    static_assert(
+        std::is_same<
+            Machine<FSM::NoInstrumentation>,
+            FSM::FSM<
+                State,
+                Transition<NotInitialized, Event0, Initialized>,
+                Transition<Initialized, Event0, Started>,
+                Transition<Started, Event1, Stopped>,
+                Transition<Stopped, Event1, Stopped>>>::value,
+        "FSM should be an uninstrumented BasicFSM");
+    static_assert(
+        Machine<FSM::TransitionCounters>::table_bytes()
+            == Machine<FSM::NoInstrumentation>::table_bytes() + 4 * 2,
+        "instrumented machines should count their accept table");
+}
+
+TEST_CASE("Transitions and rejected events are counted")
+{
+    using Counted = Machine<FSM::Instrumentation<
+        FSM::TransitionCounters,
+        FSM::RejectionCounters>>;
+
+    Counted fsm(NotInitialized);
+    const auto event0 = Counted::event_index<Event0>();
+    const auto event1 = Counted::event_index<Event1>();
+
+    REQUIRE(fsm.process(Event1()) == NotInitialized);
+    REQUIRE(fsm.process(Event0()) == Initialized);
+    REQUIRE(fsm.process_id(event0) == Started);
+    REQUIRE(fsm.process(Event0()) == Started);
+    REQUIRE(fsm.process(Unknown()) == Started);
+    REQUIRE(fsm.process_id(42) == Started);
+    REQUIRE(fsm.process_id(event1) == Stopped);
+    REQUIRE(fsm.process(Event1()) == Stopped);
+    REQUIRE(fsm.process(Event1()) == Stopped);
+
+    const auto& instruments = fsm.instruments();
+
+    REQUIRE(instruments.transition_count(NotInitialized, event0) == 1);
+    REQUIRE(instruments.transition_count(Initialized, event0) == 1);
+    REQUIRE(instruments.transition_count(Started, event1) == 1);
+    REQUIRE(instruments.transition_count(Stopped, event1) == 2);
+    REQUIRE(instruments.transition_count(Started, event0) == 0);
+
+    REQUIRE(instruments.rejection_count(NotInitialized, event1) == 1);
+    REQUIRE(instruments.rejection_count(Started, event0) == 1);
+    REQUIRE(instruments.rejection_count(Started, Counted::event_count) == 2);
+    REQUIRE(instruments.rejection_count(Stopped, event1) == 0);
+}
+
+TEST_CASE("Events rejected by guards are counted")
+{
+    using Counted = FSM::BasicFSM<
+        State,
+        FSM::Instrumentation<
+            FSM::TransitionCounters,
+            FSM::RejectionCounters>,
+        Transition<NotInitialized, Event0, Initialized>,
+        FSM::Transition<
+            State,
+            Initialized,
+            Event0,
+            Started,
+            FSM::NoAction,
+            IsAllowed>>;
+
+    Counted fsm(Initialized);
+    const auto event0 = Counted::event_index<Event0>();
+
+    allow = false;
+    REQUIRE(fsm.process(Event0()) == Initialized);
+    allow = true;
+    REQUIRE(fsm.process(Event0()) == Started);
+
+    REQUIRE(fsm.instruments().rejection_count(Initialized, event0) == 1);
+    REQUIRE(fsm.instruments().transition_count(Initialized, event0) == 1);
+}
+
+TEST_CASE("Dwell times are recorded in logarithmic buckets")
+{
+    ticks = 0;
+    Machine<FSM::DwellTimeHistograms<ManualClock, 4>> timed(NotInitialized);
+
+    ticks = 3;
+    timed.process(Event0());
+    ticks = 4;
+    timed.process(Event1());
+    timed.process(Event0());
+    ticks = 1000;
+    timed.process(Event1());
+    timed.process(Event1());
+
+    const auto& instruments = timed.instruments();
+
+    REQUIRE(
+        instruments.dwell_histogram(NotInitialized)
+        == std::array<std::uint64_t, 4>{{0, 0, 1, 0}});
+    REQUIRE(
+        instruments.dwell_histogram(Initialized)
+        == std::array<std::uint64_t, 4>{{0, 1, 0, 0}});
+    REQUIRE(
+        instruments.dwell_histogram(Started)
+        == std::array<std::uint64_t, 4>{{0, 0, 0, 1}});
+    REQUIRE(
+        instruments.dwell_histogram(Stopped)
+        == std::array<std::uint64_t, 4>{{1, 0, 0, 0}});
+}
+
+TEST_CASE("Recent transitions are traced")
+{
+    Machine<FSM::TraceBuffer<4>> fsm(NotInitialized);
+
+    REQUIRE(fsm.instruments().trace().empty());
+
+    fsm.process(Event1());
+    fsm.process(Event0());
+    fsm.process(Event0());
+    fsm.process(Event1());
+
+    std::ostringstream dump;
+    fsm.instruments().dump(dump);
+
+    REQUIRE(
+        dump.str()
+        == "1: 0 -> 1 on event 0\n"
+           "2: 1 -> 2 on event 0\n"
+           "3: 2 -> 3 on event 1\n");
+
+    for (int index = 0; index < 10; ++index)
+    {
+        fsm.process(Event1());
+    }
+
+    const auto trace = fsm.instruments().trace();
+
+    REQUIRE(trace.size() == 4);
+    REQUIRE(trace.front().sequence == 10);
+    REQUIRE(trace.back().sequence == 13);
+    REQUIRE(trace.back().from == Stopped);
+    REQUIRE(trace.back().to == Stopped);
+}
+
+TEST_CASE("Traces can be read while transitions are recorded")
+{
+    Machine<FSM::TraceBuffer<8>> fsm(Stopped);
+    const int count = 100000;
+
+    std::thread writer([&fsm] {
+        for (int index = 0; index < count; ++index)
+        {
+            fsm.process(Event1());
+        }
+    });
+
+    bool consistent = true;
+    std::uint64_t last = 0;
+
+    while (last < std::uint64_t(count))
+    {
+        const auto trace = fsm.instruments().trace();
+
+        for (std::size_t index = 0; index < trace.size(); ++index)
+        {
+            const auto& record = trace[index];
+            consistent = consistent && record.from == Stopped
+                && record.to == Stopped && record.event == 1
+                && (index == 0 || record.sequence > trace[index - 1].sequence);
+        }
+
+        if (!trace.empty()) last = trace.back().sequence;
+    }
+
+    writer.join();
+
+    REQUIRE(consistent);
+}
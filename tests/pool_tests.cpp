@@ -0,0 +1,192 @@
+#include "ring_machine.h"
+#include <catch/catch.hpp>
+#include <fsm/pool.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+// States beyond those of the transitions.
+enum Sparse
+{
+    A,
+    B,
+    Error = 200
+};
+
+template <State FromState, typename EventType, State ToState>
+using Transition = FSM::Transition<State, FromState, EventType, ToState>;
+
+using Tests::Next;
+using Tests::Ring;
+
+struct Reset {};
+
+// A ring of states, large enough to defeat the byte shuffle kernel.
+template <
+    std::size_t Size,
+    template <typename, typename...> class Machine>
+using RingOf = Tests::RingMachine<
+    Size,
+    Machine,
+    FSM::TypeList<FSM::Transition<Ring, Ring(Size - 1), Reset, Ring(0)>>>;
+
+template <std::size_t Size>
+void check_ring()
+{
+    using Pool = RingOf<Size, FSM::FSMPool>;
+    using Machine = RingOf<Size, FSM::FSM>;
+
+    const std::size_t size = 513;
+    Pool pool(size, Ring(0));
+    std::vector<Machine> machines(size, Machine(Ring(0)));
+
+    for (std::size_t index = 0; index < size; ++index)
+    {
+        pool.set_state(index, Ring(index % Size));
+        machines[index].state_ = Ring(index % Size);
+    }
+
+    for (int round = 0; round < 700; ++round)
+    {
+        if (round % 7 == 0)
+        {
+            pool.process_all(Reset());
+            for (auto& machine : machines) machine.process(Reset());
+        }
+        else
+        {
+            pool.process_all(Next());
+            for (auto& machine : machines) machine.process(Next());
+        }
+
+        const std::size_t indices[] = {1, 2, 3, 5, 8, 13, 21, 34, 55, 89, 144};
+        pool.process_indices(Next(), std::begin(indices), std::end(indices));
+        for (auto index : indices) machines[index].process(Next());
+    }
+
+    for (std::size_t index = 0; index < size; ++index)
+    {
+        REQUIRE(pool.state(index) == machines[index].state_);
+    }
+}
+
+} // namespace
+
+TEST_CASE("FSMPool matches separate FSM instances")
+{
+    using Pool = FSM::FSMPool<
+        State,
+        Transition<NotInitialized, Event0, Initialized>,
+        Transition<Initialized, Event0, Started>,
+        Transition<Started, Event1, Stopped>>;
+    using Machine = FSM::FSM<
+        State,
+        Transition<NotInitialized, Event0, Initialized>,
+        Transition<Initialized, Event0, Started>,
+        Transition<Started, Event1, Stopped>>;
+
+    static_assert(sizeof(Pool::Narrow) == 1, "states should fit in a byte");
+
+    // Odd size so that both vector and scalar code paths are exercised.
+    const std::size_t size = 1000 + 37;
+    Pool pool(size, NotInitialized);
+    std::vector<Machine> machines(size, Machine(NotInitialized));
+    std::mt19937 random(42);
+
+    for (int round = 0; round < 200; ++round)
+    {
+        const auto pick = random() % 4;
+        std::vector<std::size_t> indices;
+
+        for (int i = 0; i < 64; ++i)
+        {
+            indices.push_back(random() % size);
+        }
+
+        switch (pick)
+        {
+            case 0:
+                pool.process_all(Event0());
+                for (auto& machine : machines) machine.process(Event0());
+                break;
+            case 1:
+                pool.process_all(Event1());
+                for (auto& machine : machines) machine.process(Event1());
+                break;
+            case 2:
+                pool.process_indices(Event0(), indices.begin(), indices.end());
+                for (auto index : indices) machines[index].process(Event0());
+                break;
+            default:
+                pool.process_indices(Event1(), indices.begin(), indices.end());
+                for (auto index : indices) machines[index].process(Event1());
+                break;
+        }
+
+        if (round % 20 == 0)
+        {
+            pool.set_state(round, NotInitialized);
+            machines[round].state_ = NotInitialized;
+        }
+    }
+
+    for (std::size_t index = 0; index < size; ++index)
+    {
+        REQUIRE(pool.state(index) == machines[index].state_);
+    }
+}
+
+TEST_CASE("FSMPool with wide states")
+{
+    static_assert(
+        sizeof(RingOf<40, FSM::FSMPool>::Narrow) == 1,
+        "states should fit in a byte");
+    static_assert(
+        sizeof(RingOf<300, FSM::FSMPool>::Narrow) == 2,
+        "states should need 16 bits");
+
+    check_ring<40>();
+    check_ring<300>();
+}
+
+TEST_CASE("FSMPool processes single instances")
+{
+    FSM::FSMPool<
+        State,
+        Transition<NotInitialized, Event0, Initialized>,
+        Transition<Initialized, Event0, Started>,
+        Transition<Started, Event1, Stopped>>
+        pool(3, NotInitialized);
+
+    REQUIRE(pool.process(1, Event0()) == Initialized);
+    REQUIRE(pool.process(1, Event1()) == Initialized);
+    REQUIRE(pool.process(1, Event0()) == Started);
+    REQUIRE(pool.process(1, Event1()) == Stopped);
+    REQUIRE(pool.state(0) == NotInitialized);
+    REQUIRE(pool.state(2) == NotInitialized);
+}
+
+TEST_CASE("FSMPool rejects states appearing in no transition")
+{
+    using Pool = FSM::FSMPool<Sparse, FSM::Transition<Sparse, A, Event0, B>>;
+
+    REQUIRE_THROWS_AS(Pool(3, Error), std::out_of_range);
+
+    Pool pool(3, A);
+
+    REQUIRE_THROWS_AS(pool.set_state(1, Error), std::out_of_range);
+    pool.process_all(Event0());
+    REQUIRE(pool.state(1) == B);
+}
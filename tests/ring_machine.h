@@ -0,0 +1,87 @@
+#ifndef FSM_TESTS_RING_MACHINE_H
+#define FSM_TESTS_RING_MACHINE_H
+
+#include <fsm/fsm.h>
+
+#include <cstddef>
+#include <utility>
+
+// Machines whose states form a ring of any size, shared by the tests needing
+// more states than can be listed by hand.
+namespace Tests {
+
+enum Ring : int
+{
+};
+
+struct Next {};
+
+template <
+    typename Event,
+    std::size_t Size,
+    std::size_t Stride,
+    std::size_t Offset,
+    typename Sequence = std::make_index_sequence<(Size + Stride - 1) / Stride>>
+struct RingTransitions;
+
+// Transitions triggered by Event from every Stride-th state of a ring of Size
+// states to the state Offset further.
+template <
+    typename Event,
+    std::size_t Size,
+    std::size_t Stride,
+    std::size_t Offset,
+    std::size_t... Indices>
+struct RingTransitions<
+    Event,
+    Size,
+    Stride,
+    Offset,
+    std::index_sequence<Indices...>>
+{
+    using type = FSM::TypeList<FSM::Transition<
+        Ring,
+        Ring(Indices * Stride),
+        Event,
+        Ring((Indices * Stride + Offset) % Size)>...>;
+};
+
+template <template <typename, typename...> class Machine, typename... Lists>
+struct RingMachineHelper;
+
+template <
+    template <typename, typename...> class Machine,
+    typename... Transitions>
+struct RingMachineHelper<Machine, FSM::TypeList<Transitions...>>
+{
+    using type = Machine<Ring, Transitions...>;
+};
+
+template <
+    template <typename, typename...> class Machine,
+    typename... First,
+    typename... Second,
+    typename... Lists>
+struct RingMachineHelper<
+    Machine,
+    FSM::TypeList<First...>,
+    FSM::TypeList<Second...>,
+    Lists...>
+    : RingMachineHelper<Machine, FSM::TypeList<First..., Second...>, Lists...>
+{
+};
+
+// Machine template, such as FSM::FSM or FSM::FSMPool, instantiated with a
+// ring of Size states moving to the next one on Next, followed by the
+// transitions of Lists, which are FSM::TypeList instances.
+template <
+    std::size_t Size,
+    template <typename, typename...> class Machine,
+    typename... Lists>
+using RingMachine = typename RingMachineHelper<
+    Machine,
+    typename RingTransitions<Next, Size, 1, 1>::type,
+    Lists...>::type;
+} // namespace Tests
+
+#endif
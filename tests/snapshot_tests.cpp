@@ -0,0 +1,364 @@
+#include "ring_machine.h"
+#include <catch/catch.hpp>
+#include <fsm/snapshot.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Event0 {};
+struct Event1 {};
+
+enum State
+{
+    NotInitialized,
+    Initialized,
+    Started,
+    Stopped
+};
+
+template <State FromState, typename EventType, State ToState>
+using Transition = FSM::Transition<State, FromState, EventType, ToState>;
+
+using Pool = FSM::FSMPool<
+    State,
+    Transition<NotInitialized, Event0, Initialized>,
+    Transition<Initialized, Event0, Started>,
+    Transition<Started, Event1, Stopped>>;
+
+// Same states and events, different transitions.
+using OtherPool = FSM::FSMPool<
+    State,
+    Transition<NotInitialized, Event0, Initialized>,
+    Transition<Initialized, Event0, Started>,
+    Transition<Started, Event1, NotInitialized>,
+    Transition<Stopped, Event1, NotInitialized>>;
+
+using Tests::Ring;
+
+// A ring of states needing 9 bits, so that states straddle words.
+using Rings = Tests::RingMachine<300, FSM::FSMPool>;
+
+// Snapshot file removed at the end of a test.
+struct TemporaryFile
+{
+    ~TemporaryFile()
+    {
+        std::remove(path.c_str());
+    }
+
+    std::string path;
+};
+
+// Overwrites the 64-bit word at offset in a file.
+void overwrite(const std::string& path, std::size_t offset, std::uint64_t word)
+{
+    std::fstream stream(path, std::ios::binary | std::ios::in | std::ios::out);
+    stream.seekp(offset);
+    stream.write(reinterpret_cast<const char*>(&word), sizeof(word));
+}
+
+} // namespace
+
+TEST_CASE("Snapshot formats depend on the machine")
+{
+    using Format = FSM::SnapshotFormat<Pool>;
+
+    static_assert(Format::bits == 2, "4 states should need 2 bits");
+    static_assert(
+        FSM::SnapshotFormat<Rings>::bits == 9,
+        "300 states should need 9 bits");
+    static_assert(
+        Format::fingerprint != FSM::SnapshotFormat<OtherPool>::fingerprint,
+        "different transitions should have different fingerprints");
+}
+
+TEST_CASE("Snapshots restore the states of a pool")
+{
+    TemporaryFile file{"full_snapshot_test.fsm"};
+    Pool pool(1001, NotInitialized);
+    std::mt19937 random(42);
+
+    for (std::size_t index = 0; index < pool.size(); ++index)
+    {
+        pool.set_state(index, State(random() % 4));
+    }
+
+    FSM::save_snapshot(pool, file.path);
+
+    FSM::SnapshotView<Pool> view(file.path);
+
+    REQUIRE_FALSE(view.is_delta());
+    REQUIRE(view.size() == pool.size());
+
+    for (std::size_t index = 0; index < pool.size(); ++index)
+    {
+        REQUIRE(view.state(index) == pool.state(index));
+    }
+
+    Pool restored(pool.size(), NotInitialized);
+    FSM::restore_snapshot(restored, file.path);
+
+    for (std::size_t index = 0; index < pool.size(); ++index)
+    {
+        REQUIRE(restored.state(index) == pool.state(index));
+    }
+}
+
+TEST_CASE("Snapshots pack states across words")
+{
+    TemporaryFile file{"ring_snapshot_test.fsm"};
+    Rings pool(777, Ring(0));
+
+    for (std::size_t index = 0; index < pool.size(); ++index)
+    {
+        pool.set_state(index, Ring(index * 7 % 300));
+    }
+
+    FSM::save_snapshot(pool, file.path);
+
+    std::ifstream stream(file.path, std::ios::binary | std::ios::ate);
+    REQUIRE(std::size_t(stream.tellg()) == 56 + (777 * 9 + 63) / 64 * 8);
+
+    Rings restored(pool.size(), Ring(0));
+    FSM::restore_snapshot(restored, file.path);
+
+    for (std::size_t index = 0; index < pool.size(); ++index)
+    {
+        REQUIRE(restored.state(index) == pool.state(index));
+    }
+}
+
+TEST_CASE("Delta snapshots hold the changed instances")
+{
+    TemporaryFile full{"base_snapshot_test.fsm"};
+    TemporaryFile first{"first_delta_test.fsm"};
+    TemporaryFile second{"second_delta_test.fsm"};
+    Pool pool(100, NotInitialized);
+    FSM::DeltaCheckpoint<Pool> checkpoint(pool, full.path);
+
+    const std::size_t indices[] = {3, 50, 99};
+    pool.process_indices(Event0(), std::begin(indices), std::end(indices));
+    REQUIRE(checkpoint.save(pool, first.path) == 3);
+
+    pool.process(50, Event0());
+    pool.process(51, Event0());
+    REQUIRE(checkpoint.save(pool, second.path) == 2);
+
+    FSM::SnapshotView<Pool> view(second.path);
+
+    REQUIRE(view.is_delta());
+    REQUIRE(view.sequence() == 2);
+    REQUIRE(view.base() == FSM::SnapshotView<Pool>(full.path).base());
+
+    Pool restored(pool.size(), Stopped);
+    FSM::SnapshotPosition position;
+    FSM::restore_snapshot(restored, full.path, position);
+    FSM::restore_snapshot(restored, first.path, position);
+    FSM::restore_snapshot(restored, second.path, position);
+
+    REQUIRE(position.sequence == 2);
+
+    for (std::size_t index = 0; index < pool.size(); ++index)
+    {
+        REQUIRE(restored.state(index) == pool.state(index));
+    }
+}
+
+TEST_CASE("Delta snapshots are only restored in order after their base")
+{
+    TemporaryFile full{"chain_base_snapshot_test.fsm"};
+    TemporaryFile other{"chain_other_snapshot_test.fsm"};
+    TemporaryFile first{"chain_first_delta_test.fsm"};
+    TemporaryFile second{"chain_second_delta_test.fsm"};
+    Pool pool(10, NotInitialized);
+    FSM::DeltaCheckpoint<Pool> checkpoint(pool, full.path);
+
+    pool.process(1, Event0());
+    checkpoint.save(pool, first.path);
+    pool.process(2, Event0());
+    checkpoint.save(pool, second.path);
+
+    // Same states, another base.
+    FSM::save_snapshot(Pool(10, NotInitialized), other.path);
+
+    Pool restored(pool.size(), NotInitialized);
+    FSM::SnapshotPosition position;
+
+    REQUIRE_THROWS_AS(
+        FSM::restore_snapshot(restored, first.path), FSM::SnapshotError);
+    REQUIRE_THROWS_AS(
+        FSM::restore_snapshot(restored, first.path, position),
+        FSM::SnapshotError);
+    REQUIRE_THROWS_AS(
+        FSM::SnapshotView<Pool>(first.path).state(0), FSM::SnapshotError);
+
+    FSM::restore_snapshot(restored, other.path, position);
+    REQUIRE_THROWS_AS(
+        FSM::restore_snapshot(restored, first.path, position),
+        FSM::SnapshotError);
+
+    FSM::restore_snapshot(restored, full.path, position);
+    REQUIRE_THROWS_AS(
+        FSM::restore_snapshot(restored, second.path, position),
+        FSM::SnapshotError);
+
+    FSM::restore_snapshot(restored, first.path, position);
+    REQUIRE_THROWS_AS(
+        FSM::restore_snapshot(restored, first.path, position),
+        FSM::SnapshotError);
+
+    FSM::restore_snapshot(restored, second.path, position);
+
+    for (std::size_t index = 0; index < pool.size(); ++index)
+    {
+        REQUIRE(restored.state(index) == pool.state(index));
+    }
+}
+
+TEST_CASE("Snapshots saved concurrently to the same path stay whole")
+{
+    TemporaryFile file{"concurrent_snapshot_test.fsm"};
+    std::vector<std::thread> threads;
+
+    for (int thread = 0; thread < 4; ++thread)
+    {
+        threads.emplace_back([&file, thread] {
+            const Pool pool(1000, State(thread));
+
+            for (int round = 0; round < 20; ++round)
+            {
+                FSM::save_snapshot(pool, file.path);
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    FSM::SnapshotView<Pool> view(file.path);
+    const auto state = view.state(0);
+
+    for (std::size_t index = 0; index < view.size(); ++index)
+    {
+        REQUIRE(view.state(index) == state);
+    }
+}
+
+TEST_CASE("Invalid snapshots are rejected")
+{
+    TemporaryFile file{"invalid_snapshot_test.fsm"};
+    Pool pool(100, Started);
+
+    REQUIRE_THROWS_AS(
+        FSM::SnapshotView<Pool>("missing_snapshot_test.fsm"),
+        std::system_error);
+
+    FSM::save_snapshot(pool, file.path);
+
+    REQUIRE_THROWS_AS(
+        FSM::SnapshotView<OtherPool>(file.path), FSM::SnapshotError);
+
+    Pool smaller(99, Started);
+    REQUIRE_THROWS_AS(
+        FSM::restore_snapshot(smaller, file.path), FSM::SnapshotError);
+
+    {
+        std::ofstream stream(file.path, std::ios::binary | std::ios::app);
+        stream << "trailing";
+    }
+
+    REQUIRE_THROWS_AS(FSM::SnapshotView<Pool>(file.path), FSM::SnapshotError);
+
+    {
+        std::ofstream stream(file.path, std::ios::binary | std::ios::trunc);
+        stream << "FSMSNAP";
+    }
+
+    REQUIRE_THROWS_AS(FSM::SnapshotView<Pool>(file.path), FSM::SnapshotError);
+}
+
+TEST_CASE("Snapshots with overflowing counts are rejected")
+{
+    using Header = FSM::detail::SnapshotHeader;
+
+    TemporaryFile full{"overflow_snapshot_test.fsm"};
+    TemporaryFile delta{"overflow_delta_test.fsm"};
+    Pool pool(100, NotInitialized);
+    FSM::DeltaCheckpoint<Pool> checkpoint(pool, full.path);
+
+    pool.process(7, Event0());
+    checkpoint.save(pool, delta.path);
+
+    // Counts whose size in words wraps around to that of the file.
+    overwrite(full.path, offsetof(Header, instances), (1ull << 63) + 100);
+    overwrite(delta.path, offsetof(Header, records), (1ull << 61) + 1);
+
+    REQUIRE_THROWS_AS(FSM::SnapshotView<Pool>(full.path), FSM::SnapshotError);
+    REQUIRE_THROWS_AS(FSM::SnapshotView<Pool>(delta.path), FSM::SnapshotError);
+}
+
+TEST_CASE("Invalid snapshots leave the pool unchanged")
+{
+    TemporaryFile full{"partial_snapshot_test.fsm"};
+    TemporaryFile delta{"partial_delta_test.fsm"};
+    Rings pool(100, Ring(0));
+    FSM::DeltaCheckpoint<Rings> checkpoint(pool, full.path);
+
+    pool.process(1, Tests::Next());
+    pool.process(2, Tests::Next());
+    checkpoint.save(pool, delta.path);
+
+    // States beyond the ring in the last word, and an instance beyond the
+    // pool in the last record.
+    const auto last_word = sizeof(FSM::detail::SnapshotHeader)
+        + (100 * FSM::SnapshotFormat<Rings>::bits / 64) * 8;
+    overwrite(full.path, last_word, ~std::uint64_t(0));
+    overwrite(
+        delta.path,
+        sizeof(FSM::detail::SnapshotHeader) + 8,
+        std::uint64_t(100) << FSM::SnapshotFormat<Rings>::bits);
+
+    Rings restored(pool.size(), Ring(5));
+    FSM::SnapshotPosition position;
+
+    REQUIRE_THROWS_AS(
+        FSM::restore_snapshot(restored, full.path, position),
+        FSM::SnapshotError);
+    REQUIRE_FALSE(position.restored);
+
+    position.restored = true;
+    position.base = FSM::SnapshotView<Rings>(delta.path).base();
+
+    REQUIRE_THROWS_AS(
+        FSM::restore_snapshot(restored, delta.path, position),
+        FSM::SnapshotError);
+    REQUIRE(position.sequence == 0);
+
+    for (std::size_t index = 0; index < restored.size(); ++index)
+    {
+        REQUIRE(restored.state(index) == Ring(5));
+    }
+}
+
+TEST_CASE("Delta checkpoints reject pools of another size")
+{
+    TemporaryFile full{"size_snapshot_test.fsm"};
+    TemporaryFile delta{"size_delta_test.fsm"};
+    Pool pool(100, NotInitialized);
+    FSM::DeltaCheckpoint<Pool> checkpoint(pool, full.path);
+
+    REQUIRE_THROWS_AS(
+        checkpoint.save(Pool(50, NotInitialized), delta.path),
+        FSM::SnapshotError);
+    REQUIRE(checkpoint.save(pool, delta.path) == 0);
+}